@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "matrix.h"
+
+/// Versioned binary container of arrays, laid out so that a mapped file is read in place without parsing.
+/// The header has the version, the number of arrays, the size and a checksum of everything after the header.
+/// Each array has its type, dimensions and offset, its rows are padded like those of a matrix at an aligned offset.
+/// Values are kept in the byte order of the machine.
+namespace Binary
+{
+	constexpr char magic[4] = { 'S', 'R', 'L', 'B' };
+	constexpr std::uint32_t version = 1;
+	constexpr std::size_t alignment = 32;
+
+	struct Header
+	{
+		char magic[4];
+		std::uint32_t version;
+		std::uint32_t n_arrays;
+		std::uint32_t reserved;
+		std::uint64_t size;
+		std::uint64_t checksum;
+	};
+
+	struct Array
+	{
+		std::uint32_t type;
+		std::int32_t rows;
+		std::int32_t cols;
+		std::int32_t stride;
+		std::uint64_t offset;
+		std::uint64_t bytes;
+	};
+
+	/// Type codes of the values of arrays.
+	template <typename T>
+	struct Type;
+
+	template <>
+	struct Type<char>
+	{
+		static constexpr std::uint32_t code = 1;
+	};
+
+	template <>
+	struct Type<int>
+	{
+		static_assert(sizeof(int) == 4, "int arrays are stored with 32 bits");
+		static constexpr std::uint32_t code = 2;
+	};
+
+	template <>
+	struct Type<double>
+	{
+		static constexpr std::uint32_t code = 3;
+	};
+
+	/// Find the checksum of the words, the size is a multiple of the alignment.
+	std::uint64_t checksum(const char *data, std::size_t size);
+
+	/// Return whether the data starts like a container.
+	bool sniff(const char *data, std::size_t size);
+}
+
+/// Collects arrays in order and writes them as a container in one go.
+class BinaryWriter
+{
+public:
+	/// Add the rows of the matrix along with their padding.
+	template <typename T>
+	inline BinaryWriter &operator<<(const Matrix<T> &matrix)
+	{
+		add(Binary::Type<T>::code, matrix.rows(), matrix.cols(), matrix.stride(), reinterpret_cast<const char *>(matrix[0]), static_cast<std::size_t>(matrix.rows()) * matrix.stride() * sizeof(T));
+
+		return *this;
+	}
+
+	/// Add the vector as a single row.
+	template <typename T>
+	inline BinaryWriter &operator<<(const std::vector<T> &vec)
+	{
+		add(Binary::Type<T>::code, vec.empty() ? 0 : 1, vec.size(), vec.size(), reinterpret_cast<const char *>(vec.data()), vec.size() * sizeof(T));
+
+		return *this;
+	}
+
+	/// Add the characters of the string as a single row.
+	BinaryWriter &operator<<(const std::string &str);
+
+	/// Operator for saving the container.
+	friend std::ostream &operator<<(std::ostream &output, const BinaryWriter &writer);
+
+private:
+	std::vector<Binary::Array> arrays;
+	std::vector<char> payload;
+
+	/// Add an array with its values copied to the payload at an aligned offset.
+	void add(std::uint32_t type, int rows, int cols, int stride, const char *values, std::size_t bytes);
+};
+
+/// Reads arrays in the order they were written from a container held in memory, matrices view their rows in place.
+/// Reading an array of another type or past the end leaves the item empty and the reader invalid.
+class BinaryReader
+{
+public:
+	/// Constructor, the header and the checksum are checked.
+	BinaryReader(std::shared_ptr<const char> data, std::size_t size);
+
+	/// Return whether the container is sound and all reads so far matched.
+	bool valid() const;
+
+	/// Read the next array as a matrix.
+	template <typename T>
+	inline BinaryReader &operator>>(Matrix<T> &matrix)
+	{
+		matrix = Matrix<T>();
+		const Binary::Array *array = next(Binary::Type<T>::code);
+		if (array == nullptr || array->rows == 0)
+		{
+			return *this;
+		}
+
+		const T *values = reinterpret_cast<const T *>(data.get() + array->offset);
+		matrix = Matrix<T>(array->rows, array->cols, std::shared_ptr<const T>(data, values));
+		if (matrix.stride() != array->stride)
+		{
+			matrix = Matrix<T>();
+			q_valid = false;
+		}
+		else if (reinterpret_cast<std::uintptr_t>(values) % Matrix<T>::alignment != 0)
+		{
+			// rows need to be aligned to be viewed
+			matrix = Matrix<T>(array->rows, array->cols);
+			std::memcpy(matrix[0], values, array->bytes);
+		}
+
+		return *this;
+	}
+
+	/// Read the next array as a vector.
+	template <typename T>
+	inline BinaryReader &operator>>(std::vector<T> &vec)
+	{
+		const Binary::Array *array = next(Binary::Type<T>::code);
+		const T *values = array == nullptr ? nullptr : reinterpret_cast<const T *>(data.get() + array->offset);
+		vec = array == nullptr || array->rows == 0 ? std::vector<T>() : std::vector<T>(values, values + array->cols);
+
+		return *this;
+	}
+
+	/// Read the next array as a string.
+	BinaryReader &operator>>(std::string &str);
+
+private:
+	const std::shared_ptr<const char> data;
+	const std::size_t size;
+	bool q_valid;
+	int n_arrays;
+	int n_read;
+
+	/// Check the header, the table of arrays and the checksum.
+	bool setup() const;
+
+	/// Get the next array if it has the type.
+	const Binary::Array *next(std::uint32_t type);
+};
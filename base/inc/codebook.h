@@ -1,43 +1,75 @@
 #pragma once
 
+#include <functional>
 #include <vector>
 
+#include "binary.h"
 #include "feature.h"
+#include "gmm.h"
+#include "quantiser.h"
+#include "threads.h"
 
 struct Codebook
 {
 public:
-	std::vector<Feature> centroids;
+	Features centroids;
+	Features variances;
 
 	/// Return whether empty.
 	bool empty() const;
 
-	/// Find the buckets where the features lie in codebook.
-	std::vector<int> observations(const std::vector<Feature> &features) const;
+	/// Build the quantiser which finds the buckets where the features lie, kept by the caller across features.
+	Quantiser quantiser() const;
+
+	/// Build the gaussians of the buckets with their variances, which find the most likely buckets of the features, empty without variances.
+	GMM gmm() const;
 
 	/// Operators for loading and saving.
 	friend std::istream &operator>>(std::istream &input, Codebook &codebook);
 	friend std::ostream &operator<<(std::ostream &output, const Codebook &codebook);
+	friend BinaryReader &operator>>(BinaryReader &input, Codebook &codebook);
+	friend BinaryWriter &operator<<(BinaryWriter &output, const Codebook &codebook);
 };
 
 /// An Algorithm for Vector Quantizer Design - Y. Linde, A. Buzo and R. Gray.
 class LBG
 {
 public:
-	/// Constructor.
-	LBG(int x_codebook);
+	/// Constructor, a batch size of zero keeps the whole universe in memory.
+	LBG(int x_codebook, bool q_hamerly, int x_batch, double p_sample);
 
 	/// Call Kmeans coroutine and split the centroids and till codebook size is reached.
-	Codebook generate(const std::vector<Feature> &universe) const;
+	Codebook generate(const Features &universe, ThreadPool *thread_pool) const;
+
+	/// Call mini batch Kmeans on the universe read in chunks from the source and split the centroids till codebook size is reached.
+	Codebook generate(const std::function<Features(int)> &source, int n_chunks) const;
 
 private:
 	static constexpr double epsilon = 0.025;
 
 	const int x_codebook;
+	const bool q_hamerly;
+	const int x_batch;
+	const double p_sample;
 
 	/// Find the initial centroid of the universe.
-	static Feature mean(const std::vector<Feature> &universe);
+	static Features mean(const Features &universe);
+
+	/// Find the initial centroid of the universe read in chunks.
+	static Features mean(const std::function<Features(int)> &source, int n_chunks);
 
 	/// Split the given centroids.
-	static void split(std::vector<Feature> &centroids);
+	static void split(Features &centroids);
+
+	/// Find the variances of the buckets of the universe.
+	static Features variances(const Features &universe, const Features &centroids);
+
+	/// Find the variances of the buckets of the universe read in chunks.
+	static Features variances(const std::function<Features(int)> &source, int n_chunks, const Features &centroids);
+
+	/// Add the features to the sums and squares of their buckets.
+	static void accumulate(const Features &features, const Quantiser &quantiser, Features &sums, Features &squares, std::vector<int> &counts);
+
+	/// Find the variances from the sums and squares of the buckets.
+	static Features variances(const Features &sums, const Features &squares, const std::vector<int> &counts);
 };
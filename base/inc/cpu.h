@@ -0,0 +1,54 @@
+#pragma once
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SR_LIB_X86
+#define SR_LIB_TARGET(isa) __attribute__((target(isa)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#define SR_LIB_X86
+#define SR_LIB_TARGET(isa)
+#endif
+
+/// Instruction sets supported by the cpu, checked at runtime so that kernels can be chosen.
+namespace CPU
+{
+	/// Return whether avx2 can be used.
+	inline bool avx2()
+	{
+#if defined(SR_LIB_X86) && defined(__GNUC__)
+		__builtin_cpu_init();
+
+		return __builtin_cpu_supports("avx2");
+#elif defined(SR_LIB_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		// os should save the ymm registers
+		const bool q_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+		__cpuidex(info, 7, 0);
+		const bool q_avx2 = (info[1] & (1 << 5)) != 0;
+
+		return q_avx2 && q_ymm;
+#else
+		return false;
+#endif
+	}
+
+	/// Return whether sse2 can be used.
+	inline bool sse2()
+	{
+#if defined(SR_LIB_X86) && defined(__GNUC__)
+		__builtin_cpu_init();
+
+		return __builtin_cpu_supports("sse2");
+#elif defined(SR_LIB_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+
+		return (info[3] & (1 << 26)) != 0;
+#else
+		return false;
+#endif
+	}
+}
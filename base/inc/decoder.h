@@ -0,0 +1,67 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "hmm.h"
+
+/// Frame synchronous viterbi decoder which passes tokens through the states of all models at once.
+/// Tokens outside a global beam of the best token, or beyond the most active tokens, are pruned along with their models.
+class Decoder
+{
+public:
+	/// Log score of entering a model after the given latest models, negative infinity if not allowed.
+	typedef std::function<double(const std::vector<int> &history, int model)> LanguageScore;
+
+	/// Log emission probabilities of the states of a model at a time step.
+	typedef std::function<const double *(int model, int t)> LogEmissions;
+
+	/// Constructor, the models are not copied and should outlive, no cap on active tokens if zero.
+	Decoder(const std::vector<HMM> &hmms, double beam, int x_active, int n_best);
+
+	/// Return the indices of the best models along with their log scores, best first.
+	std::vector<std::pair<int, double>> decode(const std::vector<int> &o) const;
+
+	/// Return the indices of the best models for T time steps of given emissions along with their log scores, best first.
+	std::vector<std::pair<int, double>> decode(int T, const LogEmissions &log_emissions) const;
+
+	/// Return the best sequence of models for the observations along with its log score, tokens leave a model from its last state.
+	/// Language scores are added inside the search whenever a model is entered, they are given no more than the latest x_history models.
+	std::pair<double, std::vector<int>> decode(const std::vector<int> &o, const LanguageScore &language_score, int x_history) const;
+
+	/// Return the best sequence of models for T time steps of given emissions along with its log score.
+	std::pair<double, std::vector<int>> decode(int T, const LogEmissions &log_emissions, const LanguageScore &language_score, int x_history) const;
+
+private:
+	/// Model decoded before a token, linked to the one before it.
+	struct Link
+	{
+		int model;
+		int previous;
+	};
+
+	const std::vector<HMM> &hmms;
+	const double beam;
+	const int x_active;
+	const int n_best;
+
+	/// Get the log emissions of the observations.
+	LogEmissions log_emissions(const std::vector<int> &o) const;
+
+	/// Prune the tokens and drop the models which have none left.
+	void prune(std::vector<std::vector<double>> &deltas, std::vector<int> &active, double best_delta) const;
+
+	/// Find the score below which tokens of the active models are pruned.
+	double threshold(const std::vector<std::vector<double>> &deltas, const std::vector<int> &active, double best_delta) const;
+
+	/// Get the language scores of entering every model after the given models, found once per models.
+	const std::vector<double> &language_scores(const std::vector<int> &models, const LanguageScore &language_score, std::map<std::vector<int>, std::vector<double>> &scores) const;
+
+	/// Drop the links which no token of the active models leads to, the token links are renumbered.
+	static void compact(std::vector<Link> &links, const std::vector<std::vector<double>> &deltas, std::vector<std::vector<int>> &token_links, const std::vector<int> &active);
+
+	/// Get up to the given number of latest models linked till the given link, oldest first.
+	static std::vector<int> history(const std::vector<Link> &links, int link, int n_models);
+};
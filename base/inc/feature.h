@@ -1,29 +1,69 @@
 #pragma once
 
+#include <deque>
 #include <iostream>
 #include <vector>
 
+#include "matrix.h"
+
+/// Features of frames, one per row.
+typedef Matrix<double> Features;
+
+/// Lightweight view of a row of features.
 struct Feature
 {
 public:
-	std::vector<double> coefficients;
+	const double *coefficients;
+	int size;
+
+	/// Constructor.
+	Feature(const Features &features, int i);
 
 	/// Find the distance with another feature.
 	double distance(const Feature &feature) const;
-
-	/// Operators for loading and saving.
-	friend std::istream &operator>>(std::istream &input, Feature &feature);
-	friend std::ostream &operator<<(std::ostream &output, const Feature &feature);
 };
 
 class ICepstral
 {
 public:
+	/// Find features of frames pushed in chunks, delayed by the delta and accel windows.
+	class Stream
+	{
+	public:
+		/// Constructor.
+		Stream(const ICepstral &icepstral);
+
+		/// Push the frames and return the features which are complete.
+		Features push(const std::vector<std::vector<double>> &frames);
+
+		/// Return the remaining features.
+		Features flush();
+
+	private:
+		const ICepstral &icepstral;
+		int n_features;
+		int n_deltas;
+		int n_accels;
+		int n_mixed;
+		std::deque<std::vector<double>> features;
+		std::deque<std::vector<double>> delta_features;
+		std::deque<std::vector<double>> accel_features;
+
+		/// Find the delta of the next feature if its window is complete.
+		static bool delta(const std::deque<std::vector<double>> &features, int n_features, int n_deltas, int W, bool q_flush, std::vector<double> &delta_feature);
+
+		/// Find the features which are complete.
+		Features pop(bool q_flush);
+	};
+
 	/// Constructor.
 	ICepstral(int n_cepstral, bool q_gain, bool q_delta, bool q_accel);
 
+	/// Destructor.
+	virtual ~ICepstral() = default;
+
 	/// Get the features.
-	std::vector<Feature> features(const std::vector<std::vector<double>> &frames) const;
+	Features features(const std::vector<std::vector<double>> &frames) const;
 
 protected:
 	const int n_cepstra;
@@ -37,8 +77,8 @@ private:
 	const bool q_accel;
 
 	/// Subclasses will return coefficients for a frame.
-	virtual Feature feature(const std::vector<double> &frame) const = 0;
+	virtual std::vector<double> feature(const std::vector<double> &frame) const = 0;
 
-	/// Get delta features with given transgression window.
-	static std::vector<Feature> delta(const std::vector<Feature> &features, int W);
+	/// Write delta of the columns starting from source into the columns starting from destination.
+	static void delta(Features &features, int source, int destination, int n_columns, int W);
 };
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+
+/// Real input fast fourier transform, computed using a half size complex transform.
+/// http://www.robinscheibler.org/2013/02/13/real-fft.html
+class FFT
+{
+public:
+	/// Constructor, the size is rounded up to a power of two.
+	FFT(int n);
+
+	/// Round the size up to a power of two of at least four, which the half size transform needs.
+	static int round_size(int n);
+
+	/// Transform the real samples, zero padded to size, into the first n / 2 + 1 bins.
+	void transform(const std::vector<double> &x, std::vector<std::complex<double>> &X) const;
+
+private:
+	const int n;
+	const std::vector<int> bit_reversal;
+	const std::vector<std::complex<double>> twiddles;
+
+	/// Compute bit reversed indices for the half size transform.
+	static std::vector<int> setup_bit_reversal(int n);
+
+	/// Compute twiddle factors.
+	static std::vector<std::complex<double>> setup_twiddles(int n);
+
+	/// Cooley-Tukey, in-place, breadth-first, decimation-in-time over bit reversed values.
+	void fft(std::vector<std::complex<double>> &z) const;
+
+	/// Split the half size transform into the real transform.
+	void split(std::vector<std::complex<double>> &X) const;
+};
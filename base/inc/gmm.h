@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+
+#include "feature.h"
+#include "matrix.h"
+#include "model.h"
+
+/// Likelihoods of the most likely components of each feature, relative to the most likely one along with log of the scales.
+struct Densities
+{
+	Matrix<int> indices;
+	Matrix<double> likelihoods;
+	std::vector<double> log_scales;
+};
+
+/// Diagonal covariance gaussian mixtures of all states of a model, the mixture weights of a state are its row of b.
+/// Components of all states are transposed into one table so that a block of features is compared against all of them at once.
+/// The likelihood kernel is chosen at runtime from avx2 and scalar variants.
+class GMM
+{
+public:
+	/// Constructor.
+	GMM();
+
+	/// Constructor.
+	GMM(const Model &lambda);
+
+	/// Constructor, weights have a row of mixture weights for each state and the components of a state are consecutive rows.
+	GMM(const Matrix<double> &weights, const Matrix<double> &means, const Matrix<double> &variances);
+
+	/// Find the weighted log likelihoods of all components for each feature, one row per feature with the mixtures of a state together.
+	Matrix<double> components(const Features &features) const;
+
+	/// Find the log likelihoods of the states for each feature from those of their components.
+	Matrix<double> states(const Matrix<double> &components) const;
+
+	/// Find the given number of most likely components for each feature.
+	Densities top(const Features &features, int n_top) const;
+
+private:
+	typedef void (*Kernel)(const double *const *x, const double *means, const double *precisions, const double *constants, int n_dims, int n_padded, double *const *log_likelihoods);
+
+	static constexpr int x_block = 4;
+	static constexpr int x_lanes = 4;
+
+	int n_states;
+	int n_mixtures;
+	int n_padded;
+	Matrix<double> means;
+	Matrix<double> precisions;
+	std::vector<double> constants;
+	Kernel kernel;
+
+	/// Transpose the component rows so that a dimension of all components is contiguous, inverting the values if asked.
+	static Matrix<double> setup_table(const Matrix<double> &values, int n_padded, bool q_inverse);
+
+	/// Find the log of the weight and the normalisation of each component.
+	static std::vector<double> setup_constants(const Matrix<double> &weights, const Matrix<double> &variances, int n_padded);
+
+	/// Choose the best kernel supported by the cpu.
+	static Kernel setup_kernel();
+
+	/// Find the weighted log likelihoods of a block of features for all components.
+	static void scalar_kernel(const double *const *x, const double *means, const double *precisions, const double *constants, int n_dims, int n_padded, double *const *log_likelihoods);
+	static void avx2_kernel(const double *const *x, const double *means, const double *precisions, const double *constants, int n_dims, int n_padded, double *const *log_likelihoods);
+};
@@ -1,40 +1,171 @@
 #pragma once
 
+#include <functional>
 #include <utility>
 #include <vector>
 
+#include "feature.h"
+#include "gmm.h"
+#include "matrix.h"
 #include "model.h"
+#include "threads.h"
 
 /// http://www.ece.ucsb.edu/Faculty/Rabiner/ece259/Reprints/tutorial%20on%20hmm%20and%20applications.pdf
 /// Fundamentals of Speech Recognition - Lawrence Rabiner, Biing-Hwang Juang.
 class HMM
 {
 public:
-	/// Constructor.
-	HMM(const Model &lambda);
+	/// Constructor, tables of lambda are precomputed so that the kernels run over contiguous rows.
+	/// Banded models keep their zero transitions, the kernels only visit the band of nonzero transitions of each state.
+	HMM(const Model &lambda, bool q_band = false);
 
 	/// Optimise the given model with given observation sequence.
 	Model optimise(const std::vector<int> &o);
 
+	/// Optimise the given model with all observation sequences together, sequences are processed in the thread pool if given.
+	Model optimise(const std::vector<std::vector<int>> &os, ThreadPool *thread_pool);
+
+	/// Optimise the given continuous model with all feature sequences together, sequences are processed in the thread pool if given.
+	Model optimise(const std::vector<Features> &xs, ThreadPool *thread_pool);
+
+	/// Optimise the given semi continuous model with the densities of all feature sequences together, the shared gaussians are kept as they are.
+	Model optimise(const std::vector<Densities> &densities, ThreadPool *thread_pool);
+
 	/// Calculate how well the observations fit with scaling.
-	std::pair<double, std::vector<std::vector<double>>> forward(const std::vector<int> &o) const;
+	std::pair<double, Matrix<double>> forward(const std::vector<int> &o) const;
+
+	/// Calculate how well the observations fit with scaling, without keeping the alpha values of all time steps.
+	/// The workspace is only grown, so a reused workspace needs no allocation.
+	double score(const std::vector<int> &o, std::vector<double> &workspace) const;
+
+	/// Calculate how well the features fit a continuous model with scaling, without keeping the alpha values of all time steps.
+	double score(const Features &x, std::vector<double> &workspace) const;
+
+	/// Calculate how well the densities of features over shared gaussians fit a semi continuous model with scaling.
+	double score(const Densities &densities, std::vector<double> &workspace) const;
+
+	/// Advance scaled alpha values by one observation and return log of the scale, an empty alpha starts the model.
+	/// The new values are written into the workspace and then swapped with alpha.
+	double forward_step(std::vector<double> &alpha, int o, std::vector<double> &new_alpha) const;
+
+	/// Advance scaled alpha values by the emission probabilities of the states and return log of the scale.
+	double forward_step(std::vector<double> &alpha, const double *b, std::vector<double> &new_alpha) const;
+
+	/// Advance viterbi scores of states by one observation, tokens may also enter the model with the given score.
+	/// Return the best score, sources are the previous states of the best paths or -1 where entered, pruned states have negative infinity.
+	double viterbi_step(const std::vector<double> &delta, double entry, int o, std::vector<double> &new_delta, std::vector<int> &sources) const;
+
+	/// Advance viterbi scores of states by the log emission probabilities of the states.
+	double viterbi_step(const std::vector<double> &delta, double entry, const double *log_b, std::vector<double> &new_delta, std::vector<int> &sources) const;
+
+	/// Get the log emission probabilities of the states for an observation.
+	const double *log_emissions(int o) const;
+
+	/// Find the log emission probabilities of the states for each feature of a continuous model, one row per feature.
+	Matrix<double> log_emissions(const Features &x) const;
+
+	/// Find the log emission probabilities of the states for the densities of each feature of a semi continuous model.
+	Matrix<double> log_emissions(const Densities &densities) const;
+
+	/// Find the emission probabilities of the states for each feature of a continuous model, along with log of the scales.
+	/// Each row is scaled so that the most likely state has one, which keeps the probabilities from underflowing.
+	std::pair<std::vector<double>, Matrix<double>> emissions(const Features &x) const;
+
+	/// Find the emission probabilities of the states for the densities of each feature of a semi continuous model, along with log of the scales.
+	/// The emission of a state mixes its weights of the most likely gaussians of the feature.
+	std::pair<std::vector<double>, Matrix<double>> emissions(const Densities &densities) const;
 
 private:
+	/// Expected counts of the parameters along with the likelihood of the observations and their number.
+	/// Continuous models count mixtures in b, along with the weighted sums of features and their squares for each component.
+	struct Statistics
+	{
+		double log_P;
+		int n_observations;
+		Matrix<double> a_numerator;
+		Matrix<double> b_numerator;
+		std::vector<double> b_denominator;
+		std::vector<double> pi;
+		Matrix<double> x_numerator;
+		Matrix<double> xx_numerator;
+	};
+
 	static constexpr double minimum_probability = 10e-60;
+	static constexpr double pseudo_count = 0.01;
 	static constexpr double convergence_threshold = 1.001;
 	static constexpr int convergence_max_iterations = 50;
 
+	const bool q_band;
 	Model lambda;
+	std::vector<std::pair<int, int>> a_bands;
+	std::vector<std::pair<int, int>> at_bands;
+	Matrix<double> at;
+	Matrix<double> bt;
+	Matrix<double> log_at;
+	Matrix<double> log_bt;
+	std::vector<double> log_pi;
+	GMM gmm;
+
+	/// Transpose a and b so that the transitions into a state and the emissions of an observation are rows.
+	void setup();
+
+	/// Find the range of nonzero values of each row.
+	static std::vector<std::pair<int, int>> setup_bands(const Matrix<double> &matrix);
 
 	/// Tweak values of lambda.
 	void tweak();
 
+	/// Find the scaled alpha values of the first time step and return log of the scale.
+	double forward_start(const double *b, double *alpha) const;
+
+	/// Find the scaled alpha values of the next time step and return log of the scale.
+	double forward_step(const double *alpha, const double *b, double *alpha_next) const;
+
+	/// Scale the alpha values by the inverse of their sum.
+	void scale(double *alpha, double C) const;
+
+	/// Exponentiate the log emission probabilities relative to the most likely state of each row, along with log of the scales.
+	static std::pair<std::vector<double>, Matrix<double>> exponentiate(const Matrix<double> &log_b);
+
+	/// Take the log of the scaled emission probabilities, adding back the scales.
+	static Matrix<double> logarithm(const std::pair<std::vector<double>, Matrix<double>> &b);
+
+	/// Calculate how well the scaled emission probabilities fit, without keeping the alpha values of all time steps.
+	double score(const std::pair<std::vector<double>, Matrix<double>> &b, std::vector<double> &workspace) const;
+
+	/// Gather the emission probabilities of the states for each observation, one row per observation.
+	Matrix<double> emissions(const std::vector<int> &o) const;
+
 	/// Calculate the best possible path with scaling.
 	std::pair<double, std::vector<int>> viterbi(const std::vector<int> &o) const;
 
-	/// Calculate beta values with scaling.
-	std::vector<std::vector<double>> backward(const std::vector<int> &o) const;
+	/// Calculate alpha values with scaling from the emission probabilities of each time step.
+	std::pair<double, Matrix<double>> forward(const Matrix<double> &b) const;
+
+	/// Calculate beta values with scaling from the emission probabilities of each time step.
+	Matrix<double> backward(const Matrix<double> &b) const;
+
+	/// Get statistics with all counts zero.
+	Statistics zero_statistics() const;
+
+	/// Add the expected counts of transitions from the emission probabilities of each time step, and return the probabilities of states at each time step.
+	Matrix<double> expect(const Matrix<double> &b, Statistics &statistics) const;
+
+	/// Find the expected counts of the observation sequence, expectation step of Baum Welch algorithm.
+	Statistics expect(const std::vector<int> &o) const;
+
+	/// Find the expected counts of the feature sequence of a continuous model.
+	Statistics expect(const Features &x) const;
+
+	/// Find the expected counts of the densities of a feature sequence of a semi continuous model.
+	Statistics expect(const Densities &densities) const;
+
+	/// Sum the expected counts of all sequences in order.
+	Statistics expect_all(int n_sequences, const std::function<Statistics(int)> &expect_sequence, ThreadPool *thread_pool) const;
+
+	/// Optimise with the expected counts of all sequences till the likelihood converges.
+	Model optimise(int n_sequences, const std::function<Statistics(int)> &expect_sequence, ThreadPool *thread_pool);
 
-	/// Improve Model by using Baum Whelch algorithm.
-	void restimate(const std::vector<int> &o);
+	/// Improve Model from the expected counts, maximisation step of Baum Welch algorithm.
+	void maximise(const Statistics &statistics);
 };
@@ -1,13 +1,34 @@
 #pragma once
 
+#include <cctype>
+#include <charconv>
+#include <cstring>
 #include <iostream>
+#include <iterator>
 #include <limits>
 #include <string>
 #include <sstream>
+#include <streambuf>
+#include <type_traits>
 #include <vector>
 
 namespace IO
 {
+	/// Whether the items are numbers which are converted without streams, characters and bools are left to streams.
+	template <typename T>
+	constexpr bool is_number = std::is_floating_point<T>::value || (std::is_integral<T>::value && !std::is_same<T, bool>::value && sizeof(T) > 1);
+
+	/// Stream buffer which reads characters in place.
+	class CharsBuffer : public std::streambuf
+	{
+	public:
+		/// Constructor.
+		inline CharsBuffer(const char *first, const char *last)
+		{
+			setg(const_cast<char *>(first), const_cast<char *>(first), const_cast<char *>(last));
+		}
+	};
+
 	/// Get the item from the stream.
 	template <typename T>
 	inline T get_item_from_stream(std::istream &stream)
@@ -18,88 +39,168 @@ namespace IO
 		return item;
 	}
 
+	/// Get the item from the characters, numbers and strings are read the way a stream would read them.
+	template <typename T>
+	inline T get_item_from_chars(const char *first, const char *last)
+	{
+		T item = T();
+
+		while (first != last && std::isspace(static_cast<unsigned char>(*first)))
+		{
+			++first;
+		}
+		if constexpr (is_number<T>)
+		{
+			first += first != last && *first == '+' ? 1 : 0;
+			std::from_chars(first, last, item);
+		}
+		else if constexpr (std::is_same<T, std::string>::value)
+		{
+			const char *end = first;
+			while (end != last && !std::isspace(static_cast<unsigned char>(*end)))
+			{
+				++end;
+			}
+			item.assign(first, end);
+		}
+		else
+		{
+			std::stringstream stream(std::string(first, last));
+			stream >> item;
+		}
+
+		return item;
+	}
+
+	/// Append the string form of the item, numbers keep all digits needed to read them back exactly.
+	template <typename T>
+	inline void append_string_from_item(std::string &str, const T &item)
+	{
+		if constexpr (is_number<T>)
+		{
+			char chars[64];
+			std::to_chars_result result;
+			if constexpr (std::is_floating_point<T>::value)
+			{
+				// same as a scientific stream with maximum precision
+				result = std::to_chars(chars, chars + sizeof(chars), item, std::chars_format::scientific, std::numeric_limits<T>::max_digits10);
+			}
+			else
+			{
+				result = std::to_chars(chars, chars + sizeof(chars), item);
+			}
+			str.append(chars, result.ptr);
+		}
+		else if constexpr (std::is_same<T, std::string>::value)
+		{
+			str += item;
+		}
+		else
+		{
+			std::stringstream stream;
+			// maximise precision
+			stream.precision(std::numeric_limits<double>::max_digits10);
+			stream.setf(std::ios::scientific);
+			stream << item;
+			str += stream.str();
+		}
+	}
+
 	/// Set the item to a string form.
 	template <typename T>
 	inline std::string get_string_from_item(const T &item)
 	{
-		std::stringstream stream;
-		// maximise precision
-		stream.precision(std::numeric_limits<double>::max_digits10);
-		stream.setf(std::ios::scientific);
-		stream << item;
+		std::string str;
+		append_string_from_item<T>(str, item);
 
-		return stream.str();
+		return str;
 	}
 
-	/// Get the vector from the stream.
+	/// Get the vector from the characters.
 	template <typename T>
-	inline std::vector<T> get_vector_from_stream(std::istream &stream, char delim = ',')
+	inline std::vector<T> get_vector_from_chars(const char *first, const char *last, char delim = ',')
 	{
 		std::vector<T> vec;
 
-		std::string token;
-		while (getline(stream, token, delim))
+		while (first != last)
 		{
-			std::stringstream token_stream(token);
-			vec.push_back(get_item_from_stream<T>(token_stream));
+			const char *end = static_cast<const char *>(std::memchr(first, delim, last - first));
+			end = end == nullptr ? last : end;
+			vec.push_back(get_item_from_chars<T>(first, end));
+			first = end == last ? last : end + 1;
 		}
 
 		return vec;
 	}
 
+	/// Get the vector from the stream.
+	template <typename T>
+	inline std::vector<T> get_vector_from_stream(std::istream &stream, char delim = ',')
+	{
+		const std::string chars{ std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>() };
+
+		return get_vector_from_chars<T>(chars.data(), chars.data() + chars.size(), delim);
+	}
+
 	/// Set the vector to a string form.
 	template <typename T>
 	inline std::string get_string_from_vector(const std::vector<T> &vec, char delim = ',')
 	{
-		if (vec.empty())
-		{
-			return std::string();
-		}
+		std::string str;
 
-		std::stringstream stream;
-
-		for (int i = 0; i < vec.size() - 1; ++i)
+		for (int i = 0; i < vec.size(); ++i)
 		{
-			stream << get_string_from_item<T>(vec[i]) << delim;
+			if (i > 0)
+			{
+				str += delim;
+			}
+			append_string_from_item<T>(str, vec[i]);
 		}
-		stream << get_string_from_item<T>(vec[vec.size() - 1]);
 
-		return stream.str();
+		return str;
 	}
 
-	/// Get the matrix from the stream.
+	/// Get the matrix from the characters.
 	template <typename T>
-	inline std::vector<std::vector<T>> get_matrix_from_stream(std::istream &stream, char delim_token = ',', char delim_line = '\n')
+	inline std::vector<std::vector<T>> get_matrix_from_chars(const char *first, const char *last, char delim_token = ',', char delim_line = '\n')
 	{
 		std::vector<std::vector<T>> mat;
 
-		std::string line;
-		while (getline(stream, line, delim_line))
+		while (first != last)
 		{
-			std::stringstream line_stream(line);
-			mat.push_back(get_vector_from_stream<T>(line_stream, delim_token));
+			const char *end = static_cast<const char *>(std::memchr(first, delim_line, last - first));
+			end = end == nullptr ? last : end;
+			mat.push_back(get_vector_from_chars<T>(first, end, delim_token));
+			first = end == last ? last : end + 1;
 		}
 
 		return mat;
 	}
 
+	/// Get the matrix from the stream.
+	template <typename T>
+	inline std::vector<std::vector<T>> get_matrix_from_stream(std::istream &stream, char delim_token = ',', char delim_line = '\n')
+	{
+		const std::string chars{ std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>() };
+
+		return get_matrix_from_chars<T>(chars.data(), chars.data() + chars.size(), delim_token, delim_line);
+	}
+
 	/// Set the matrix to a string form.
 	template <typename T>
 	inline std::string get_string_from_matrix(const std::vector<std::vector<T>> &mat, char delim_token = ',', char delim_line = '\n')
 	{
-		if (mat.empty())
-		{
-			return std::string();
-		}
-
-		std::stringstream stream;
+		std::string str;
 
-		for (int i = 0; i < mat.size() - 1; ++i)
+		for (int i = 0; i < mat.size(); ++i)
 		{
-			stream << get_string_from_vector<T>(mat[i], delim_token) << delim_line;
+			if (i > 0)
+			{
+				str += delim_line;
+			}
+			str += get_string_from_vector<T>(mat[i], delim_token);
 		}
-		stream << get_string_from_vector<T>(mat[mat.size() - 1], delim_token);
 
-		return stream.str();
+		return str;
 	}
 }
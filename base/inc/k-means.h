@@ -1,29 +1,72 @@
 #pragma once
 
+#include <functional>
 #include <utility>
 #include <vector>
 
 #include "feature.h"
+#include "quantiser.h"
+#include "threads.h"
 
 /// Fundamentals of Speech Recognition - Lawrence Rabiner, Biing-Hwang Juang.
 class KMeans
 {
 public:
-	/// Constructor.
-	KMeans(const std::vector<Feature> &universe);
+	/// Constructor, the universe is not copied and should outlive, parts of it are processed in the thread pool if given.
+	/// Hamerly bounds skip the distance evaluations of points whose nearest centroid can not have changed.
+	KMeans(const Features &universe, ThreadPool *thread_pool, bool q_hamerly);
 
 	/// Optimise the centroids.
-	std::vector<Feature> optimise(const std::vector<Feature> &centroids) const;
+	Features optimise(const Features &centroids) const;
 
 	/// Classify the universe into buckets.
-	std::pair<double, std::vector<int>> classify(const std::vector<Feature> &centroids) const;
+	std::pair<double, std::vector<int>> classify(const Features &centroids) const;
 
 private:
 	static constexpr double convergence_threshold = 0.0000001;
 	static constexpr int convergence_max_iterations = 50;
+	static constexpr int x_part = 4096;
 
-	const std::vector<Feature> universe;
+	const Features &universe;
+	ThreadPool *const thread_pool;
+	const bool q_hamerly;
+
+	/// Classify the universe into buckets using the bounds, all points are compared if there are no old indices.
+	std::pair<double, std::vector<int>> classify(const Features &old_centroids, const Features &centroids, const std::vector<int> &old_indices, std::vector<double> &lower_bounds) const;
 
 	/// Locate centroids by taking means of vectors that have been put into respective buckets.
-	void relocate(const std::vector<int> &indices, std::vector<Feature> &centroids) const;
+	void relocate(const std::vector<int> &indices, Features &centroids) const;
+
+	/// Classify the given part of the universe and return its distance.
+	double classify_part(const Quantiser &quantiser, int part, std::vector<int> &indices) const;
+
+	/// Classify the given part of the universe using the bounds and return its distance.
+	double classify_bounded_part(const Quantiser &quantiser, const std::vector<double> &half_distances, const std::vector<double> &drifts, bool q_bounded, int part, std::vector<int> &indices, std::vector<double> &lower_bounds) const;
+
+	/// Sum the vectors of the given part of the universe in respective buckets.
+	std::pair<Features, std::vector<int>> relocate_part(const std::vector<int> &indices, int n_centroids, int part) const;
+};
+
+/// Web-Scale K-Means Clustering - D. Sculley.
+class MiniBatchKMeans
+{
+public:
+	/// Constructor, the source is not copied and should outlive, its chunks of the universe are sampled into batches.
+	MiniBatchKMeans(const std::function<Features(int)> &source, int n_chunks, int x_batch, double p_sample);
+
+	/// Optimise the centroids.
+	Features optimise(const Features &centroids) const;
+
+private:
+	static constexpr double convergence_threshold = 0.001;
+	static constexpr int convergence_max_epochs = 20;
+	static constexpr unsigned int seed = 5489u;
+
+	const std::function<Features(int)> &source;
+	const int n_chunks;
+	const int x_batch;
+	const double p_sample;
+
+	/// Move the centroids towards the vectors of the batch and return the distance of the batch before moving.
+	static double update(const Features &batch, std::vector<int> &bucket_sizes, Features &centroids);
 };
@@ -19,7 +19,7 @@ private:
 	static std::vector<double> setup_sine_coefficients(int n_cepstra);
 
 	/// Find the lpcc features for given frame.
-	Feature feature(const std::vector<double> &frame) const;
+	std::vector<double> feature(const std::vector<double> &frame) const;
 
 	/// Find autocorrelation of a fram.
 	std::vector<double> auto_correlation(const std::vector<double> &frame) const;
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "io.h"
+
+/// Allocator that aligns the storage so that rows can be loaded with simd instructions.
+template <typename T, int alignment>
+struct AlignedAllocator
+{
+public:
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind
+	{
+		typedef AlignedAllocator<U, alignment> other;
+	};
+
+	/// Constructor.
+	inline AlignedAllocator()
+	{
+	}
+
+	/// Constructor.
+	template <typename U>
+	inline AlignedAllocator(const AlignedAllocator<U, alignment> &)
+	{
+	}
+
+	/// Allocate aligned memory, the original pointer is stored right before the aligned one.
+	inline T *allocate(std::size_t n)
+	{
+		char *memory = static_cast<char *>(::operator new(n * sizeof(T) + alignment + sizeof(void *)));
+		std::uintptr_t aligned = (reinterpret_cast<std::uintptr_t>(memory) + sizeof(void *) + alignment - 1) & ~static_cast<std::uintptr_t>(alignment - 1);
+		reinterpret_cast<void **>(aligned)[-1] = memory;
+
+		return reinterpret_cast<T *>(aligned);
+	}
+
+	/// Deallocate the original pointer.
+	inline void deallocate(T *p, std::size_t)
+	{
+		::operator delete(reinterpret_cast<void **>(p)[-1]);
+	}
+
+	/// Allocators are stateless.
+	template <typename U>
+	inline bool operator==(const AlignedAllocator<U, alignment> &) const
+	{
+		return true;
+	}
+
+	/// Allocators are stateless.
+	template <typename U>
+	inline bool operator!=(const AlignedAllocator<U, alignment> &) const
+	{
+		return false;
+	}
+};
+
+/// Row major matrix stored contiguously, rows are padded with zeroes to the alignment.
+/// A matrix may view rows owned by someone else, such as a mapped file, they are copied on the first change.
+template <typename T>
+class Matrix
+{
+public:
+	static constexpr int alignment = 32;
+
+	/// Constructor.
+	inline Matrix() :
+		n_rows(0), n_cols(0), n_stride(0), values(), view()
+	{
+	}
+
+	/// Constructor.
+	inline Matrix(int n_rows, int n_cols, T value = T()) :
+		n_rows(n_rows), n_cols(n_cols), n_stride(setup_stride(n_cols)), values(), view()
+	{
+		values.resize(offset(n_rows), T());
+		for (int i = 0; i < n_rows; ++i)
+		{
+			for (int j = 0; j < n_cols; ++j)
+			{
+				values[offset(i) + j] = value;
+			}
+		}
+	}
+
+	/// Constructor, the rows are viewed in place and must be laid out with the stride of the columns.
+	inline Matrix(int n_rows, int n_cols, std::shared_ptr<const T> view) :
+		n_rows(n_rows), n_cols(n_cols), n_stride(setup_stride(n_cols)), values(), view(view)
+	{
+	}
+
+	/// Return the number of rows.
+	inline int rows() const
+	{
+		return n_rows;
+	}
+
+	/// Return the number of columns.
+	inline int cols() const
+	{
+		return n_cols;
+	}
+
+	/// Return the distance between two rows.
+	inline int stride() const
+	{
+		return n_stride;
+	}
+
+	/// Return whether empty.
+	inline bool empty() const
+	{
+		return n_rows == 0;
+	}
+
+	/// Get the row.
+	inline T *operator[](int i)
+	{
+		own();
+
+		return values.data() + offset(i);
+	}
+
+	/// Get the row.
+	inline const T *operator[](int i) const
+	{
+		return data() + offset(i);
+	}
+
+	/// Resize the rows, keeping the columns.
+	inline void resize(int rows, T value = T())
+	{
+		own();
+		const int old_rows = n_rows;
+		n_rows = rows;
+		values.resize(offset(n_rows), T());
+		for (int i = old_rows; i < n_rows; ++i)
+		{
+			for (int j = 0; j < n_cols; ++j)
+			{
+				values[offset(i) + j] = value;
+			}
+		}
+	}
+
+	/// Reserve space for rows.
+	inline void reserve(int rows)
+	{
+		own();
+		values.reserve(offset(rows));
+	}
+
+	/// Append a row, the columns are taken from the first row.
+	inline void push_back(const std::vector<T> &row)
+	{
+		own();
+		if (n_rows == 0 && n_cols == 0)
+		{
+			n_cols = row.size();
+			n_stride = setup_stride(n_cols);
+		}
+
+		values.resize(offset(n_rows + 1), T());
+		for (int j = 0; j < n_cols && j < row.size(); ++j)
+		{
+			values[offset(n_rows) + j] = row[j];
+		}
+		n_rows++;
+	}
+
+	/// Append the rows of the given matrix with same columns.
+	inline void append(const Matrix<T> &matrix)
+	{
+		own();
+		if (n_rows == 0 && n_cols == 0)
+		{
+			n_cols = matrix.n_cols;
+			n_stride = matrix.n_stride;
+		}
+
+		values.insert(values.end(), matrix.data(), matrix.data() + matrix.offset(matrix.n_rows));
+		n_rows += matrix.n_rows;
+	}
+
+	/// Return the transposed matrix.
+	inline Matrix<T> transpose() const
+	{
+		Matrix<T> matrix(n_cols, n_rows);
+
+		for (int i = 0; i < n_rows; ++i)
+		{
+			for (int j = 0; j < n_cols; ++j)
+			{
+				matrix[j][i] = (*this)[i][j];
+			}
+		}
+
+		return matrix;
+	}
+
+	/// Operator for loading, one row per line.
+	friend std::istream &operator>>(std::istream &input, Matrix<T> &matrix)
+	{
+		matrix = Matrix<T>();
+
+		std::string line;
+		while (getline(input, line))
+		{
+			matrix.push_back(IO::get_vector_from_chars<T>(line.data(), line.data() + line.size()));
+		}
+
+		return input;
+	}
+
+	/// Operator for saving, one row per line.
+	friend std::ostream &operator<<(std::ostream &output, const Matrix<T> &matrix)
+	{
+		std::string line;
+
+		for (int i = 0; i < matrix.n_rows; ++i)
+		{
+			line.clear();
+			for (int j = 0; j < matrix.n_cols; ++j)
+			{
+				IO::append_string_from_item<T>(line, matrix[i][j]);
+				line += j < matrix.n_cols - 1 ? "," : "";
+			}
+			if (i < matrix.n_rows - 1)
+			{
+				line += '\n';
+			}
+			output.write(line.data(), line.size());
+		}
+
+		return output;
+	}
+
+private:
+	int n_rows;
+	int n_cols;
+	int n_stride;
+	std::vector<T, AlignedAllocator<T, alignment>> values;
+	std::shared_ptr<const T> view;
+
+	/// Get the first row, viewed or owned.
+	inline const T *data() const
+	{
+		return view ? view.get() : values.data();
+	}
+
+	/// Copy the viewed rows so that they can be changed.
+	inline void own()
+	{
+		if (view)
+		{
+			values.assign(view.get(), view.get() + offset(n_rows));
+			view.reset();
+		}
+	}
+
+	/// Get the offset of the row from the first, in size_t so that large matrices do not overflow.
+	inline std::size_t offset(int i) const
+	{
+		return static_cast<std::size_t>(i) * n_stride;
+	}
+
+	/// Round up the columns to the alignment.
+	static inline int setup_stride(int n_cols)
+	{
+		const int n_align = alignment / sizeof(T) > 0 ? alignment / sizeof(T) : 1;
+
+		return (n_cols + n_align - 1) / n_align * n_align;
+	}
+};
@@ -1,49 +1,50 @@
 #pragma once
 
-#include <complex>
 #include <map>
 #include <vector>
 
 #include "feature.h"
+#include "fft.h"
 
 /// https://github.com/dspavankumar/compute-mfcc
 class MFC : public ICepstral
 {
 public:
-	/// Constructor.
-	MFC(int n_cepstra, bool q_gain, bool q_delta, bool q_accel);
+	/// Constructor, the number of fft points is rounded up to a power of two.
+	MFC(int n_cepstra, bool q_gain, bool q_delta, bool q_accel, int n_filters, int n_fft, double hz_low, double hz_high, double hz_sampling);
 
 private:
-	static constexpr int n_fft = 512;
-	static constexpr double hz_low = 50;
-	static constexpr double hz_high = 6500;
-	static constexpr double hz_sampling = 16000;
-	static constexpr int n_filters = 40;
-	static constexpr int n_fft_bins = 247;
-
-	const std::vector<std::vector<double>> filter_bank;
+	/// Triangular filter stored from its first non zero bin.
+	struct Filter
+	{
+		int bin;
+		std::vector<double> weights;
+	};
+
+	const int n_filters;
+	const int n_fft;
+	const int n_fft_bins;
+	const FFT fft;
+	const std::vector<Filter> filter_bank;
 	const std::vector<std::vector<double>> dct_matrix;
 
 	/// Compute filterbank.
-	static std::vector<std::vector<double>> setup_filter_bank();
+	static std::vector<Filter> setup_filter_bank(int n_filters, int n_fft_bins, double hz_low, double hz_high, double hz_sampling);
 
 	/// Compute dct matrix.
-	static std::vector<std::vector<double>> setup_dct_matrix(int n_cepstra);
+	static std::vector<std::vector<double>> setup_dct_matrix(int n_cepstra, int n_filters);
 
 	/// Find mfcc features for given frame.
-	Feature feature(const std::vector<double> &frame) const;
+	std::vector<double> feature(const std::vector<double> &frame) const;
 
-	/// Find power spectrum.
-	std::vector<double> power_spectrum(const std::vector<double> &frame) const;
+	/// Find power spectrum into the given buffer.
+	void power_spectrum(const std::vector<double> &frame, std::vector<double> &P) const;
 
-	/// Cooley-Tukey, in-place, breadth-first, decimation-in-frequency.
-	void fft(std::vector<std::complex<double>> &x) const;
+	/// Apply log Mel filterbank into the given buffer.
+	void lmfb(const std::vector<double> &P, std::vector<double> &H) const;
 
-	/// Apply log Mel filterbank.
-	std::vector<double> lmfb(const std::vector<double> &P) const;
-
-	/// Compute discrete cosine transform.
-	std::vector<double> dct(const std::vector<double> &H) const;
+	/// Compute discrete cosine transform into the given coefficients.
+	void dct(const std::vector<double> &H, std::vector<double> &C) const;
 
 	/// Balance the coefficients by subtracting mean.
 	void normalise(std::vector<double> &C) const;
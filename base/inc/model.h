@@ -3,6 +3,10 @@
 #include <iostream>
 #include <vector>
 
+#include "binary.h"
+#include "feature.h"
+#include "matrix.h"
+
 struct Model
 {
 public:
@@ -15,23 +19,34 @@ public:
 		/// Get a feed forward model.
 		Model bakis() const;
 
-		/// Merge the given models.
-		Model merge(const std::vector<Model> &models) const;
+		/// Get a feed forward model with M gaussian mixtures per state, initialised from equal segments of the features.
+		Model bakis(const std::vector<Features> &xs) const;
 
 	private:
+		static constexpr double epsilon = 0.2;
+
 		int N;
 		int M;
 		int step;
 	};
 
-	std::vector<std::vector<double>> a;
-	std::vector<std::vector<double>> b;
+	static constexpr double minimum_variance = 10e-4;
+
+	Matrix<double> a;
+	Matrix<double> b;
 	std::vector<double> pi;
+	Matrix<double> means;
+	Matrix<double> variances;
 
 	/// Return whether empty.
 	bool empty() const;
 
+	/// Return whether emissions are gaussian mixtures, then b has the mixture weights and each state has M rows of means and variances.
+	bool continuous() const;
+
 	/// Operators for loading and saving.
 	friend std::istream &operator>>(std::istream &input, Model &model);
 	friend std::ostream &operator<<(std::ostream &output, const Model &model);
+	friend BinaryReader &operator>>(BinaryReader &input, Model &model);
+	friend BinaryWriter &operator<<(BinaryWriter &output, const Model &model);
 };
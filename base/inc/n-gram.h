@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 
+#include "binary.h"
+
 struct Gram
 {
 	std::map<std::vector<std::string>, int> counts;
@@ -15,6 +17,8 @@ struct Gram
 	/// Operators for loading and saving.
 	friend std::istream &operator>>(std::istream &input, Gram &gram);
 	friend std::ostream &operator<<(std::ostream &output, const Gram &gram);
+	friend BinaryReader &operator>>(BinaryReader &input, Gram &gram);
+	friend BinaryWriter &operator<<(BinaryWriter &output, const Gram &gram);
 };
 
 /// https://github.com/Elucidation/Ngram-Tutorial/blob/master/NgramTutorial.ipynb
@@ -22,10 +26,17 @@ class MLE
 {
 private:
 	std::vector<Gram> grams;
+	std::vector<std::map<std::vector<int>, int>> indexed_counts;
 
 public:
 	MLE(std::vector<Gram> grams);
 
+	/// Constructor, the keys of the grams are also kept by the indices of their words, keys with other words are left out.
+	MLE(std::vector<Gram> grams, const std::vector<std::string> &words);
+
 	/// Return the probability of word with given context.
 	double score(const std::vector<std::string> &context, const std::string &word) const;
+
+	/// Return the probability of word with given context, by the indices of the words.
+	double score(const std::vector<int> &context, int word) const;
 };
@@ -6,6 +6,41 @@
 class Preprocessor
 {
 public:
+	/// Process samples pushed in chunks using running estimates.
+	class Stream
+	{
+	public:
+		/// Constructor.
+		Stream(const Preprocessor &preprocessor);
+
+		/// Push the samples and return the frames which are complete.
+		std::vector<std::vector<double>> push(const std::vector<double> &samples);
+
+		/// Process the remaining samples and return the last frames.
+		std::vector<std::vector<double>> flush();
+
+	private:
+		const Preprocessor &preprocessor;
+		int n_samples;
+		double sum_samples;
+		double max_sample;
+		bool q_bg;
+		double mean_bg;
+		double sd_bg;
+		double emphasized_sample;
+		std::vector<double> trim_samples;
+		std::vector<double> frame_samples;
+
+		/// Find the background from the samples waiting to be trimmed.
+		void background();
+
+		/// Trim the complete windows and return the voiced samples.
+		std::vector<double> trim();
+
+		/// Normalise, premphasize and frame the samples.
+		std::vector<std::vector<double>> framing(const std::vector<double> &samples);
+	};
+
 	/// Constructor.
 	Preprocessor(bool q_trim, int x_frame, int x_overlap);
 
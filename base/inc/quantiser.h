@@ -0,0 +1,49 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "feature.h"
+
+/// Find the nearest centroids of features, a block of features is compared against a transposed centroid table.
+/// The distance kernel is chosen at runtime from avx2, sse2 and scalar variants.
+class Quantiser
+{
+public:
+	/// Constructor.
+	Quantiser(const Features &centroids);
+
+	/// Find the nearest centroids of the features along with the total distance.
+	std::pair<double, std::vector<int>> classify(const Features &features) const;
+
+	/// Find the nearest centroids of the features in given range and return their total distance.
+	double classify(const Features &features, int begin, int end, std::vector<int> &indices) const;
+
+	/// Find the nearest and second nearest centroids of the given rows of features, one entry per row.
+	void nearest(const Features &features, const std::vector<int> &rows, std::vector<int> &indices, std::vector<double> &distances, std::vector<double> &second_distances) const;
+
+	/// Find the distance of a feature from a centroid, rounded the same as in the kernels.
+	double distance(const double *x, int j) const;
+
+private:
+	typedef void (*Kernel)(const double *const *x, const double *table, int n_dims, int x_stride, int n_padded, double *distances);
+
+	static constexpr int x_block = 4;
+	static constexpr int x_lanes = 4;
+
+	const int n_centroids;
+	const int n_padded;
+	const Matrix<double> table;
+	const Kernel kernel;
+
+	/// Transpose the centroids so that a dimension of all centroids is contiguous.
+	static Matrix<double> setup_table(const Features &centroids, int n_padded);
+
+	/// Choose the best kernel supported by the cpu.
+	static Kernel setup_kernel();
+
+	/// Find the distances from a block of features to all centroids, the rows of the table are x_stride apart.
+	static void scalar_kernel(const double *const *x, const double *table, int n_dims, int x_stride, int n_padded, double *distances);
+	static void sse2_kernel(const double *const *x, const double *table, int n_dims, int x_stride, int n_padded, double *distances);
+	static void avx2_kernel(const double *const *x, const double *table, int n_dims, int x_stride, int n_padded, double *distances);
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "matrix.h"
+
+/// Digital Audio Resampling - Julius O. Smith, https://ccrma.stanford.edu/~jos/resample/
+/// Polyphase windowed sinc resampler between two integer rates, samples are pushed in chunks.
+/// Each output sample uses the phase of the filter at its position between the input samples, equal rates are passed through.
+class Resampler
+{
+public:
+	/// Constructor.
+	Resampler(int hz_input, int hz_output);
+
+	/// Push the samples and return the resampled samples which are complete.
+	std::vector<double> push(const std::vector<double> &samples);
+
+	/// Resample the remaining samples and return the last resampled samples.
+	std::vector<double> flush();
+
+private:
+	static constexpr int n_zeros = 16;
+
+	const int n_up;
+	const int n_down;
+	const int x_half;
+	const Matrix<double> phases;
+	std::int64_t n_input;
+	std::int64_t n_output;
+	std::int64_t first;
+	std::vector<double> history;
+
+	/// Find the number of taps on either side of an output sample.
+	static int setup_half(int n_up, int n_down);
+
+	/// Setup the blackman windowed sinc of each phase, normalised to unit gain.
+	static Matrix<double> setup_phases(int n_up, int n_down, int x_half);
+
+	/// Resample the output samples whose taps are all in the history, up to the given number of output samples.
+	std::vector<double> resample(std::int64_t n_limit);
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "matrix.h"
+#include "model.h"
+#include "threads.h"
+
+/// Forward scores of all models at once, the tables keep one column per model so that a frame advances every model in the same loop.
+/// Models with fewer states or symbols are padded with zero probabilities.
+class Scorer
+{
+public:
+	/// Constructor.
+	Scorer(const std::vector<Model> &models);
+
+	/// Return the log likelihoods of the observations for all models, parts of the models are scored in the thread pool if given.
+	std::vector<double> score(const std::vector<int> &o, ThreadPool *thread_pool) const;
+
+	/// Advance the scaled alphas of all models by one observation into new alphas and add the log of the scales, empty alphas start the models.
+	/// New alphas are only allocated when their size is wrong, so alphas that are swapped and reused need no allocation.
+	void step(const Matrix<double> &alpha, int o, Matrix<double> &new_alpha, std::vector<double> &log_Ps) const;
+
+private:
+	static constexpr int x_part = 64;
+	static constexpr int x_lanes = Matrix<double>::alignment / sizeof(double);
+
+	const int n_models;
+	const int n_states;
+	const Matrix<double> pi;
+	const Matrix<double> at;
+	const Matrix<double> bt;
+	const std::vector<std::pair<int, int>> at_bands;
+
+	/// Find the most states and symbols of the models.
+	static int setup_states(const std::vector<Model> &models);
+	static int setup_symbols(const std::vector<Model> &models);
+
+	/// Lay out the initial probabilities, one row per state.
+	static Matrix<double> setup_pi(const std::vector<Model> &models, int n_states);
+
+	/// Lay out the transitions into each state, one row per state and source state.
+	static Matrix<double> setup_at(const std::vector<Model> &models, int n_states);
+
+	/// Lay out the emissions of each observation, one row per observation and state.
+	static Matrix<double> setup_bt(const std::vector<Model> &models, int n_states, int n_symbols);
+
+	/// Find the range of source states with a nonzero transition into each state in any model.
+	static std::vector<std::pair<int, int>> setup_bands(const std::vector<Model> &models, int n_states);
+
+	/// Score the observations for the models of a part.
+	void score_part(const std::vector<int> &o, int part, std::vector<double> &log_Ps) const;
+
+	/// Advance the alphas of the models in given range of columns, the alphas keep only the columns of the range.
+	void step(const Matrix<double> &alpha, int o, int begin, int end, Matrix<double> &new_alpha, std::vector<double> &log_Ps) const;
+};
@@ -0,0 +1,138 @@
+#include "binary.h"
+
+#include <algorithm>
+
+using namespace std;
+
+/// FNV-1a over words instead of bytes.
+uint64_t Binary::checksum(const char *data, size_t size)
+{
+	uint64_t hash = 14695981039346656037ull;
+
+	for (size_t i = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, data + i, sizeof(uint64_t));
+		hash = (hash ^ word) * 1099511628211ull;
+	}
+
+	return hash;
+}
+
+bool Binary::sniff(const char *data, size_t size)
+{
+	return size >= sizeof(Header) && memcmp(data, magic, sizeof(magic)) == 0;
+}
+
+BinaryWriter &BinaryWriter::operator<<(const string &str)
+{
+	add(Binary::Type<char>::code, str.empty() ? 0 : 1, str.size(), str.size(), str.data(), str.size());
+
+	return *this;
+}
+
+/// The table of arrays comes right after the header, so the payload offsets are only known when writing.
+ostream &operator<<(ostream &output, const BinaryWriter &writer)
+{
+	const size_t x_table = writer.arrays.size() * sizeof(Binary::Array);
+	const size_t payload_offset = (sizeof(Binary::Header) + x_table + Binary::alignment - 1) / Binary::alignment * Binary::alignment;
+	vector<char> container(payload_offset + writer.payload.size(), 0);
+
+	Binary::Array *arrays = reinterpret_cast<Binary::Array *>(container.data() + sizeof(Binary::Header));
+	for (int i = 0; i < writer.arrays.size(); ++i)
+	{
+		arrays[i] = writer.arrays[i];
+		arrays[i].offset += payload_offset;
+	}
+	copy(writer.payload.begin(), writer.payload.end(), container.begin() + payload_offset);
+
+	Binary::Header header{ {}, Binary::version, static_cast<uint32_t>(writer.arrays.size()), 0, container.size(), 0 };
+	memcpy(header.magic, Binary::magic, sizeof(Binary::magic));
+	header.checksum = Binary::checksum(container.data() + sizeof(Binary::Header), container.size() - sizeof(Binary::Header));
+	memcpy(container.data(), &header, sizeof(Binary::Header));
+	output.write(container.data(), container.size());
+
+	return output;
+}
+
+/// Payload is padded after every array, which keeps the size a multiple of the alignment.
+void BinaryWriter::add(uint32_t type, int rows, int cols, int stride, const char *values, size_t bytes)
+{
+	arrays.push_back(Binary::Array{ type, rows, cols, stride, payload.size(), bytes });
+	if (bytes > 0)
+	{
+		payload.insert(payload.end(), values, values + bytes);
+	}
+	payload.resize((payload.size() + Binary::alignment - 1) / Binary::alignment * Binary::alignment, 0);
+}
+
+BinaryReader::BinaryReader(shared_ptr<const char> data, size_t size) :
+	data(data), size(size), q_valid(false), n_arrays(0), n_read(0)
+{
+	q_valid = setup();
+	if (q_valid)
+	{
+		n_arrays = reinterpret_cast<const Binary::Header *>(data.get())->n_arrays;
+	}
+}
+
+bool BinaryReader::valid() const
+{
+	return q_valid;
+}
+
+BinaryReader &BinaryReader::operator>>(string &str)
+{
+	const Binary::Array *array = next(Binary::Type<char>::code);
+	str = array == nullptr || array->rows == 0 ? string() : string(data.get() + array->offset, array->cols);
+
+	return *this;
+}
+
+bool BinaryReader::setup() const
+{
+	if (data == nullptr || !Binary::sniff(data.get(), size) || size % Binary::alignment != 0)
+	{
+		return false;
+	}
+
+	Binary::Header header;
+	memcpy(&header, data.get(), sizeof(Binary::Header));
+	if (header.version != Binary::version || header.size != size || sizeof(Binary::Header) + header.n_arrays * sizeof(Binary::Array) > size)
+	{
+		return false;
+	}
+
+	const Binary::Array *arrays = reinterpret_cast<const Binary::Array *>(data.get() + sizeof(Binary::Header));
+	for (int i = 0; i < header.n_arrays; ++i)
+	{
+		const Binary::Array &array = arrays[i];
+		const size_t x_value = array.type == Binary::Type<char>::code ? sizeof(char) : array.type == Binary::Type<int>::code ? sizeof(int) : array.type == Binary::Type<double>::code ? sizeof(double) : 0;
+		if (x_value == 0 || array.rows < 0 || array.cols < 0 || array.stride < array.cols || array.bytes != static_cast<uint64_t>(array.rows) * array.stride * x_value || array.offset + array.bytes > size)
+		{
+			return false;
+		}
+	}
+
+	return header.checksum == Binary::checksum(data.get() + sizeof(Binary::Header), size - sizeof(Binary::Header));
+}
+
+const Binary::Array *BinaryReader::next(uint32_t type)
+{
+	if (!q_valid || n_read >= n_arrays)
+	{
+		q_valid = false;
+
+		return nullptr;
+	}
+
+	const Binary::Array *array = reinterpret_cast<const Binary::Array *>(data.get() + sizeof(Binary::Header)) + n_read++;
+	if (array->type != type)
+	{
+		q_valid = false;
+
+		return nullptr;
+	}
+
+	return array;
+}
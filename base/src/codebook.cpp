@@ -1,7 +1,9 @@
 #include "codebook.h"
 
+#include <sstream>
+#include <string>
+
 #include "k-means.h"
-#include "io.h"
 
 using namespace std;
 
@@ -10,37 +12,75 @@ bool Codebook::empty() const
 	return centroids.empty();
 }
 
-vector<int> Codebook::observations(const vector<Feature> &features) const
+Quantiser Codebook::quantiser() const
 {
-	return KMeans(features).classify(centroids).second;
+	return Quantiser(centroids);
+}
+
+GMM Codebook::gmm() const
+{
+	if (variances.empty())
+	{
+		return GMM();
+	}
+
+	return GMM(Matrix<double>(centroids.rows(), 1, 1.0), centroids, variances);
 }
 
 istream &operator>>(istream &input, Codebook &codebook)
 {
-	codebook.centroids = IO::get_vector_from_stream<Feature>(input, '\n');
+	string line;
+	stringstream stream;
+
+	while (getline(input, line) && line != "variances")
+	{
+		stream << line << '\n';
+	}
+	stream >> codebook.centroids;
+	stream = stringstream();
+	while (getline(input, line))
+	{
+		stream << line << '\n';
+	}
+	stream >> codebook.variances;
 
 	return input;
 }
 
 ostream &operator<<(ostream &output, const Codebook &codebook)
 {
-	output << IO::get_string_from_vector<Feature>(codebook.centroids, '\n');
+	output << codebook.centroids;
+	if (!codebook.variances.empty())
+	{
+		output << '\n' << "variances" << '\n';
+		output << codebook.variances;
+	}
 
 	return output;
 }
 
-LBG::LBG(int x_codebook) :
-	x_codebook(x_codebook)
+BinaryReader &operator>>(BinaryReader &input, Codebook &codebook)
+{
+	return input >> codebook.centroids >> codebook.variances;
+}
+
+BinaryWriter &operator<<(BinaryWriter &output, const Codebook &codebook)
+{
+	return output << codebook.centroids << codebook.variances;
+}
+
+LBG::LBG(int x_codebook, bool q_hamerly, int x_batch, double p_sample) :
+	x_codebook(x_codebook), q_hamerly(q_hamerly), x_batch(x_batch), p_sample(p_sample)
 {
 }
 
-Codebook LBG::generate(const vector<Feature> &universe) const
+Codebook LBG::generate(const Features &universe, ThreadPool *thread_pool) const
 {
 	Codebook codebook;
 
 	int m = 1;
-	const KMeans kmeans(universe);
-	codebook.centroids = vector<Feature>(1, mean(universe));
+	const KMeans kmeans(universe, thread_pool, q_hamerly);
+	codebook.centroids = mean(universe);
 	do
 	{
 		m *= 2;
@@ -48,40 +88,146 @@ Codebook LBG::generate(const vector<Feature> &universe) const
 		split(codebook.centroids);
 		codebook.centroids = kmeans.optimise(codebook.centroids);
 	} while (m < x_codebook);
+	codebook.variances = variances(universe, codebook.centroids);
 
 	return codebook;
 }
 
-Feature LBG::mean(const vector<Feature> &universe)
+Codebook LBG::generate(const function<Features(int)> &source, int n_chunks) const
 {
-	Feature mean{ vector<double>(universe[0].coefficients.size(), 0.0) };
+	Codebook codebook;
 
-	for (int i = 0; i < universe.size(); ++i)
+	int m = 1;
+	const MiniBatchKMeans kmeans(source, n_chunks, x_batch, p_sample);
+	codebook.centroids = mean(source, n_chunks);
+	do
 	{
-		for (int j = 0; j < universe[0].coefficients.size(); ++j)
+		m *= 2;
+
+		split(codebook.centroids);
+		codebook.centroids = kmeans.optimise(codebook.centroids);
+	} while (m < x_codebook);
+	codebook.variances = variances(source, n_chunks, codebook.centroids);
+
+	return codebook;
+}
+
+Features LBG::mean(const Features &universe)
+{
+	Features mean(1, universe.cols(), 0.0);
+
+	for (int i = 0; i < universe.rows(); ++i)
+	{
+		for (int j = 0; j < universe.cols(); ++j)
 		{
-			mean.coefficients[j] += universe[i].coefficients[j];
+			mean[0][j] += universe[i][j];
 		}
 	}
-	for (int i = 0; i < mean.coefficients.size(); ++i)
+	for (int i = 0; i < mean.cols(); ++i)
 	{
-		mean.coefficients[i] /= universe.size();
+		mean[0][i] /= universe.rows();
 	}
 
 	return mean;
 }
 
-void LBG::split(vector<Feature> &centroids)
+Features LBG::mean(const function<Features(int)> &source, int n_chunks)
 {
-	const int N = centroids.size();
-	centroids.resize(N * 2, Feature{ vector<double>(centroids[0].coefficients.size(), 0.0) });
+	Features mean;
+	long long n_rows = 0;
+
+	for (int c = 0; c < n_chunks; ++c)
+	{
+		const Features chunk = source(c);
+		if (mean.empty() && !chunk.empty())
+		{
+			mean = Features(1, chunk.cols(), 0.0);
+		}
+		for (int i = 0; i < chunk.rows(); ++i)
+		{
+			for (int j = 0; j < chunk.cols(); ++j)
+			{
+				mean[0][j] += chunk[i][j];
+			}
+		}
+		n_rows += chunk.rows();
+	}
+	for (int i = 0; i < mean.cols(); ++i)
+	{
+		mean[0][i] /= n_rows;
+	}
+
+	return mean;
+}
+
+void LBG::split(Features &centroids)
+{
+	const int N = centroids.rows();
+	centroids.resize(N * 2, 0.0);
 
 	for (int i = 0; i < N; ++i)
 	{
-		for (int j = 0; j < centroids[0].coefficients.size(); ++j)
+		for (int j = 0; j < centroids.cols(); ++j)
+		{
+			centroids[N + i][j] = centroids[i][j] - epsilon;
+			centroids[i][j] += epsilon;
+		}
+	}
+}
+
+Features LBG::variances(const Features &universe, const Features &centroids)
+{
+	Features sums(centroids.rows(), centroids.cols(), 0.0), squares(centroids.rows(), centroids.cols(), 0.0);
+	vector<int> counts(centroids.rows(), 0);
+
+	accumulate(universe, Quantiser(centroids), sums, squares, counts);
+
+	return variances(sums, squares, counts);
+}
+
+Features LBG::variances(const function<Features(int)> &source, int n_chunks, const Features &centroids)
+{
+	Features sums(centroids.rows(), centroids.cols(), 0.0), squares(centroids.rows(), centroids.cols(), 0.0);
+	vector<int> counts(centroids.rows(), 0);
+
+	const Quantiser quantiser(centroids);
+	for (int c = 0; c < n_chunks; ++c)
+	{
+		accumulate(source(c), quantiser, sums, squares, counts);
+	}
+
+	return variances(sums, squares, counts);
+}
+
+void LBG::accumulate(const Features &features, const Quantiser &quantiser, Features &sums, Features &squares, vector<int> &counts)
+{
+	const vector<int> indices = quantiser.classify(features).second;
+	for (int i = 0; i < features.rows(); ++i)
+	{
+		const int j = indices[i];
+		for (int d = 0; d < features.cols(); ++d)
 		{
-			centroids[N + i].coefficients[j] = centroids[i].coefficients[j] - epsilon;
-			centroids[i].coefficients[j] += epsilon;
+			sums[j][d] += features[i][d];
+			squares[j][d] += features[i][d] * features[i][d];
 		}
+		counts[j]++;
 	}
 }
+
+/// Buckets left empty keep unit variances.
+Features LBG::variances(const Features &sums, const Features &squares, const vector<int> &counts)
+{
+	Features variances(sums.rows(), sums.cols(), 1.0);
+
+	for (int j = 0; j < sums.rows(); ++j)
+	{
+		for (int d = 0; d < sums.cols() && counts[j] > 0; ++d)
+		{
+			const double mean = sums[j][d] / counts[j];
+			const double variance = squares[j][d] / counts[j] - mean * mean;
+			variances[j][d] = variance < Model::minimum_variance ? Model::minimum_variance : variance;
+		}
+	}
+
+	return variances;
+}
@@ -0,0 +1,306 @@
+#include "decoder.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+Decoder::Decoder(const vector<HMM> &hmms, double beam, int x_active, int n_best) :
+	hmms(hmms), beam(beam), x_active(x_active), n_best(n_best)
+{
+}
+
+vector<pair<int, double>> Decoder::decode(const vector<int> &o) const
+{
+	return decode(o.size(), log_emissions(o));
+}
+
+vector<pair<int, double>> Decoder::decode(int T, const LogEmissions &log_emissions) const
+{
+	vector<pair<int, double>> best;
+
+	vector<vector<double>> deltas(hmms.size()), new_deltas(hmms.size());
+	vector<int> active(hmms.size(), 0), sources;
+	for (int i = 0; i < active.size(); ++i)
+	{
+		active[i] = i;
+	}
+	for (int t = 0; t < T; ++t)
+	{
+		// all models are entered at the first frame
+		const double entry = t == 0 ? 0.0 : -numeric_limits<double>::infinity();
+		double best_delta = -numeric_limits<double>::infinity();
+		for (int i = 0; i < active.size(); ++i)
+		{
+			const int m = active[i];
+			best_delta = max(best_delta, hmms[m].viterbi_step(deltas[m], entry, log_emissions(m, t), new_deltas[m], sources));
+			deltas[m].swap(new_deltas[m]);
+		}
+		prune(deltas, active, best_delta);
+	}
+
+	for (int i = 0; i < active.size() && T > 0; ++i)
+	{
+		const int m = active[i];
+		best.push_back(pair<int, double>(m, *max_element(deltas[m].begin(), deltas[m].end())));
+	}
+	const int n = min(n_best, (int)best.size());
+	partial_sort(best.begin(), best.begin() + n, best.end(), [](const pair<int, double> &a, const pair<int, double> &b) { return a.second > b.second; });
+	best.resize(n);
+
+	return best;
+}
+
+pair<double, vector<int>> Decoder::decode(const vector<int> &o, const LanguageScore &language_score, int x_history) const
+{
+	return decode(o.size(), log_emissions(o), language_score, x_history);
+}
+
+/// Every token remembers the link of the model decoded before it, a link is made whenever tokens leave a model.
+/// Leaving tokens with the same latest models are recombined as the language scores cannot tell them apart, and only the best is linked.
+/// Links are compacted once they have doubled since they were last compacted.
+pair<double, vector<int>> Decoder::decode(int T, const LogEmissions &log_emissions, const LanguageScore &language_score, int x_history) const
+{
+	pair<double, vector<int>> best(-numeric_limits<double>::infinity(), vector<int>());
+
+	const int n_models = hmms.size();
+	int x_links = n_models;
+	vector<Link> links;
+	map<vector<int>, vector<double>> scores;
+	map<vector<int>, pair<double, Link>> exits;
+	vector<vector<double>> deltas(n_models), new_deltas(n_models);
+	vector<vector<int>> token_links(n_models), new_token_links(n_models);
+	vector<double> entries(n_models);
+	vector<int> entry_links(n_models), active, sources;
+	for (int t = 0; t < T; ++t)
+	{
+		// tokens in the last states of models leave them, the best of each history enters every model with the language score
+		fill(entries.begin(), entries.end(), -numeric_limits<double>::infinity());
+		fill(entry_links.begin(), entry_links.end(), -1);
+		if (t == 0)
+		{
+			entries = language_scores(vector<int>(), language_score, scores);
+		}
+		exits.clear();
+		for (int i = 0; i < active.size(); ++i)
+		{
+			const int m = active[i], last = deltas[m].size() - 1;
+			if (deltas[m][last] == -numeric_limits<double>::infinity())
+			{
+				continue;
+			}
+
+			vector<int> models = history(links, token_links[m][last], x_history - 1);
+			if (x_history > 0)
+			{
+				models.push_back(m);
+			}
+			pair<double, Link> &exit = exits.insert(make_pair(models, make_pair(-numeric_limits<double>::infinity(), Link{ m, -1 }))).first->second;
+			if (exit.first < deltas[m][last])
+			{
+				exit = make_pair(deltas[m][last], Link{ m, token_links[m][last] });
+			}
+		}
+		for (map<vector<int>, pair<double, Link>>::const_iterator it = exits.begin(); it != exits.end(); ++it)
+		{
+			links.push_back(it->second.second);
+			const vector<double> &entry_scores = language_scores(it->first, language_score, scores);
+			for (int w = 0; w < n_models; ++w)
+			{
+				const double entry = it->second.first + entry_scores[w];
+				if (entries[w] < entry)
+				{
+					entries[w] = entry;
+					entry_links[w] = links.size() - 1;
+				}
+			}
+		}
+
+		// advance the models which have tokens or are being entered
+		active.clear();
+		double best_delta = -numeric_limits<double>::infinity();
+		for (int w = 0; w < n_models; ++w)
+		{
+			if (deltas[w].empty() && entries[w] == -numeric_limits<double>::infinity())
+			{
+				continue;
+			}
+
+			best_delta = max(best_delta, hmms[w].viterbi_step(deltas[w], entries[w], log_emissions(w, t), new_deltas[w], sources));
+			new_token_links[w].resize(sources.size());
+			for (int i = 0; i < sources.size(); ++i)
+			{
+				new_token_links[w][i] = sources[i] < 0 ? entry_links[w] : token_links[w][sources[i]];
+			}
+			deltas[w].swap(new_deltas[w]);
+			token_links[w].swap(new_token_links[w]);
+			active.push_back(w);
+		}
+		prune(deltas, active, best_delta);
+
+		if (links.size() > 2 * x_links)
+		{
+			compact(links, deltas, token_links, active);
+			x_links = max(n_models, static_cast<int>(links.size()));
+		}
+	}
+
+	// the utterance should end in the last state of a model, any state is taken if none does
+	for (int q_last = 1; q_last >= 0 && best.second.empty(); --q_last)
+	{
+		int best_m = -1, best_i = -1;
+		for (int i = 0; i < active.size(); ++i)
+		{
+			const int m = active[i];
+			for (int j = q_last ? deltas[m].size() - 1 : 0; j < deltas[m].size(); ++j)
+			{
+				if (best.first < deltas[m][j])
+				{
+					best.first = deltas[m][j];
+					best_m = m;
+					best_i = j;
+				}
+			}
+		}
+		if (best_m >= 0)
+		{
+			best.second = history(links, token_links[best_m][best_i], numeric_limits<int>::max());
+			best.second.push_back(best_m);
+		}
+	}
+
+	return best;
+}
+
+Decoder::LogEmissions Decoder::log_emissions(const vector<int> &o) const
+{
+	return [this, &o](int model, int t) { return hmms[model].log_emissions(o[t]); };
+}
+
+void Decoder::prune(vector<vector<double>> &deltas, vector<int> &active, double best_delta) const
+{
+	const double min_delta = threshold(deltas, active, best_delta);
+
+	int n_active = 0;
+	for (int i = 0; i < active.size(); ++i)
+	{
+		const int m = active[i];
+		bool q_active = false;
+		for (int j = 0; j < deltas[m].size(); ++j)
+		{
+			if (deltas[m][j] < min_delta)
+			{
+				deltas[m][j] = -numeric_limits<double>::infinity();
+			}
+			q_active = q_active || deltas[m][j] != -numeric_limits<double>::infinity();
+		}
+		if (q_active)
+		{
+			active[n_active++] = m;
+		}
+		else
+		{
+			deltas[m].clear();
+		}
+	}
+	active.resize(n_active);
+}
+
+/// The beam gives the threshold unless there are more tokens inside it than the cap, then the score of the last allowed token is taken.
+double Decoder::threshold(const vector<vector<double>> &deltas, const vector<int> &active, double best_delta) const
+{
+	const double min_delta = best_delta - beam;
+	if (x_active <= 0)
+	{
+		return min_delta;
+	}
+
+	vector<double> scores;
+	for (int i = 0; i < active.size(); ++i)
+	{
+		const vector<double> &delta = deltas[active[i]];
+		for (int j = 0; j < delta.size(); ++j)
+		{
+			if (delta[j] >= min_delta)
+			{
+				scores.push_back(delta[j]);
+			}
+		}
+	}
+	if (scores.size() <= x_active)
+	{
+		return min_delta;
+	}
+	nth_element(scores.begin(), scores.begin() + x_active - 1, scores.end(), greater<double>());
+
+	return scores[x_active - 1];
+}
+
+const vector<double> &Decoder::language_scores(const vector<int> &models, const LanguageScore &language_score, map<vector<int>, vector<double>> &scores) const
+{
+	map<vector<int>, vector<double>>::iterator it = scores.find(models);
+	if (it == scores.end())
+	{
+		vector<double> entry_scores(hmms.size());
+		for (int w = 0; w < entry_scores.size(); ++w)
+		{
+			entry_scores[w] = language_score(models, w);
+		}
+		it = scores.insert(make_pair(models, entry_scores)).first;
+	}
+
+	return it->second;
+}
+
+/// Kept links stay in order, so a link is always renumbered after the one before it.
+void Decoder::compact(vector<Link> &links, const vector<vector<double>> &deltas, vector<vector<int>> &token_links, const vector<int> &active)
+{
+	// mark the links which live tokens lead to
+	vector<int> indices(links.size(), -1);
+	for (int i = 0; i < active.size(); ++i)
+	{
+		const int m = active[i];
+		for (int j = 0; j < deltas[m].size(); ++j)
+		{
+			for (int link = deltas[m][j] == -numeric_limits<double>::infinity() ? -1 : token_links[m][j]; link >= 0 && indices[link] < 0; link = links[link].previous)
+			{
+				indices[link] = 0;
+			}
+		}
+	}
+
+	int n_links = 0;
+	for (int link = 0; link < links.size(); ++link)
+	{
+		if (indices[link] < 0)
+		{
+			continue;
+		}
+
+		indices[link] = n_links;
+		links[n_links++] = Link{ links[link].model, links[link].previous < 0 ? -1 : indices[links[link].previous] };
+	}
+	links.resize(n_links);
+
+	for (int i = 0; i < active.size(); ++i)
+	{
+		const int m = active[i];
+		for (int j = 0; j < deltas[m].size(); ++j)
+		{
+			token_links[m][j] = deltas[m][j] == -numeric_limits<double>::infinity() || token_links[m][j] < 0 ? -1 : indices[token_links[m][j]];
+		}
+	}
+}
+
+vector<int> Decoder::history(const vector<Link> &links, int link, int n_models)
+{
+	vector<int> models;
+
+	for (; link >= 0 && static_cast<int>(models.size()) < n_models; link = links[link].previous)
+	{
+		models.push_back(links[link].model);
+	}
+	reverse(models.begin(), models.end());
+
+	return models;
+}
@@ -2,35 +2,135 @@
 
 #include <cmath>
 
-#include "io.h"
-
 using namespace std;
 
+Feature::Feature(const Features &features, int i) :
+	coefficients(features[i]), size(features.cols())
+{
+}
+
 double Feature::distance(const Feature &feature) const
 {
 	double distance = 0.0;
 
-	for (int i = 0; i < coefficients.size() && i < feature.coefficients.size(); ++i)
+	for (int i = 0; i < size && i < feature.size; ++i)
 	{
 		// euclidean distance
-		distance += pow((coefficients[i] - feature.coefficients[i]), 2);
+		const double difference = coefficients[i] - feature.coefficients[i];
+		distance += difference * difference;
 	}
 
 	return distance;
 }
 
-istream &operator>>(istream &input, Feature &feature)
+ICepstral::Stream::Stream(const ICepstral &icepstral) :
+	icepstral(icepstral), n_features(0), n_deltas(0), n_accels(0), n_mixed(0),
+	features(), delta_features(), accel_features()
 {
-	feature.coefficients = IO::get_vector_from_stream<double>(input);
+}
 
-	return input;
+Features ICepstral::Stream::push(const vector<vector<double>> &frames)
+{
+	const int offset = icepstral.q_gain ? 0 : 1;
+	for (int i = 0; i < frames.size(); ++i)
+	{
+		const vector<double> frame_feature = icepstral.feature(frames[i]);
+		features.push_back(vector<double>(frame_feature.begin() + offset, frame_feature.end()));
+		n_features++;
+	}
+
+	return pop(false);
 }
 
-ostream &operator<<(ostream &output, const Feature &feature)
+Features ICepstral::Stream::flush()
 {
-	output << IO::get_string_from_vector<double>(feature.coefficients);
+	return pop(true);
+}
 
-	return output;
+/// Edges of the utterance are copied as it is, same as the batch delta.
+bool ICepstral::Stream::delta(const deque<vector<double>> &features, int n_features, int n_deltas, int W, bool q_flush, vector<double> &delta_feature)
+{
+	const int first = n_features - features.size(), i = n_deltas;
+	if (i >= n_features)
+	{
+		return false;
+	}
+	if (i < W || (q_flush && i >= n_features - W))
+	{
+		delta_feature = features[i - first];
+		return true;
+	}
+	if (i + W >= n_features)
+	{
+		// wait for the window to complete
+		return false;
+	}
+
+	delta_feature = vector<double>(features[i - first].size(), 0.0);
+	const double denominator = W * (W + 1.0) * (2.0 * W + 1.0) / 3.0 - pow(W, 2);
+	for (int j = 0; j < delta_feature.size(); ++j)
+	{
+		double numerator = 0.0;
+		for (int k = -W; k <= W; ++k)
+		{
+			numerator += k * features[k + i - first][j];
+		}
+		delta_feature[j] = numerator / denominator;
+	}
+
+	return true;
+}
+
+Features ICepstral::Stream::pop(bool q_flush)
+{
+	Features mixed_features;
+
+	vector<double> feature;
+	while (icepstral.q_delta && delta(features, n_features, n_deltas, x_delta_window, q_flush, feature))
+	{
+		delta_features.push_back(feature);
+		n_deltas++;
+	}
+	while (icepstral.q_delta && icepstral.q_accel && delta(delta_features, n_deltas, n_accels, x_accel_window, q_flush, feature))
+	{
+		accel_features.push_back(feature);
+		n_accels++;
+	}
+
+	const int n_complete = icepstral.q_delta ? (icepstral.q_accel ? n_accels : n_deltas) : n_features;
+	for (; n_mixed < n_complete; ++n_mixed)
+	{
+		vector<double> mixed_feature = features[n_mixed - (n_features - features.size())];
+		if (icepstral.q_delta)
+		{
+			const vector<double> &delta_feature = delta_features[n_mixed - (n_deltas - delta_features.size())];
+			mixed_feature.insert(mixed_feature.end(), delta_feature.begin(), delta_feature.end());
+			if (icepstral.q_accel)
+			{
+				const vector<double> &accel_feature = accel_features[n_mixed - (n_accels - accel_features.size())];
+				mixed_feature.insert(mixed_feature.end(), accel_feature.begin(), accel_feature.end());
+			}
+		}
+		mixed_features.push_back(mixed_feature);
+	}
+
+	// forget what is not needed by the windows anymore
+	const int first_feature = icepstral.q_delta ? min(n_mixed, n_deltas - x_delta_window) : n_mixed;
+	const int first_delta = icepstral.q_accel ? min(n_mixed, n_accels - x_accel_window) : n_mixed;
+	while (!features.empty() && n_features - (int)features.size() < first_feature)
+	{
+		features.pop_front();
+	}
+	while (!delta_features.empty() && n_deltas - (int)delta_features.size() < first_delta)
+	{
+		delta_features.pop_front();
+	}
+	while (!accel_features.empty() && n_accels - (int)accel_features.size() < n_mixed)
+	{
+		accel_features.pop_front();
+	}
+
+	return mixed_features;
 }
 
 ICepstral::ICepstral(int n_cepstra, bool q_gain, bool q_delta, bool q_accel) :
@@ -38,34 +138,28 @@ ICepstral::ICepstral(int n_cepstra, bool q_gain, bool q_delta, bool q_accel) :
 {
 }
 
-vector<Feature> ICepstral::features(const vector<vector<double>> &frames) const
+Features ICepstral::features(const vector<vector<double>> &frames) const
 {
-	vector<Feature> mixed_features(frames.size(), Feature{ vector<double>() });
+	const int offset = q_gain ? 0 : 1, n_columns = n_cepstra + 1 - offset;
+	const int n_blocks = 1 + (q_delta ? 1 : 0) + (q_delta && q_accel ? 1 : 0);
+	Features mixed_features(frames.size(), n_columns * n_blocks);
 
-	vector<Feature> features(frames.size(), Feature{ vector<double>() });
-	const int offset = q_gain ? 0 : 1;
 	for (int i = 0; i < frames.size(); ++i)
 	{
-		const Feature frame_feature = feature(frames[i]);
-		features[i].coefficients.insert(features[i].coefficients.end(), frame_feature.coefficients.begin() + offset, frame_feature.coefficients.end());
-		mixed_features[i].coefficients.insert(mixed_features[i].coefficients.end(), features[i].coefficients.begin(), features[i].coefficients.end());
+		const vector<double> frame_feature = feature(frames[i]);
+		for (int j = 0; j < n_columns; ++j)
+		{
+			mixed_features[i][j] = frame_feature[j + offset];
+		}
 	}
 
 	if (q_delta)
 	{
-		const vector<Feature> delta_features = delta(features, x_delta_window);
-		for (int i = 0; i < frames.size(); ++i)
-		{
-			mixed_features[i].coefficients.insert(mixed_features[i].coefficients.end(), delta_features[i].coefficients.begin(), delta_features[i].coefficients.end());
-		}
+		delta(mixed_features, 0, n_columns, n_columns, x_delta_window);
 
 		if (q_accel)
 		{
-			const vector<Feature> accel_features = delta(delta_features, x_accel_window);
-			for (int i = 0; i < frames.size(); ++i)
-			{
-				mixed_features[i].coefficients.insert(mixed_features[i].coefficients.end(), accel_features[i].coefficients.begin(), accel_features[i].coefficients.end());
-			}
+			delta(mixed_features, n_columns, 2 * n_columns, n_columns, x_accel_window);
 		}
 	}
 
@@ -73,23 +167,39 @@ vector<Feature> ICepstral::features(const vector<vector<double>> &frames) const
 }
 
 /// http://www1.icsi.berkeley.edu/Speech/docs/HTKBook/node65_mn.html
-vector<Feature> ICepstral::delta(const vector<Feature> &features, int W)
+void ICepstral::delta(Features &features, int source, int destination, int n_columns, int W)
 {
-	vector<Feature> delta = features;
+	const int T = features.rows();
 
 	const double denominator = W * (W + 1.0) * (2.0 * W + 1.0) / 3.0 - pow(W, 2);
-	for (int i = W; i < (int)features.size() - W; ++i)
+	for (int i = 0; i < T; ++i)
 	{
-		for (int j = 0; j < features[0].coefficients.size(); ++j)
+		double *delta_feature = features[i] + destination;
+		if (i < W || i >= T - W)
 		{
-			double numerator = 0.0;
-			for (int k = -W; k <= W; ++k)
+			// edges are copied as it is
+			for (int j = 0; j < n_columns; ++j)
 			{
-				numerator += k * features[k + i].coefficients[j];
+				delta_feature[j] = features[i][source + j];
 			}
-			delta[i].coefficients[j] = numerator / denominator;
+			continue;
 		}
-	}
 
-	return delta;
+		for (int j = 0; j < n_columns; ++j)
+		{
+			delta_feature[j] = 0.0;
+		}
+		for (int k = -W; k <= W; ++k)
+		{
+			const double *window_feature = features[k + i] + source;
+			for (int j = 0; j < n_columns; ++j)
+			{
+				delta_feature[j] += k * window_feature[j];
+			}
+		}
+		for (int j = 0; j < n_columns; ++j)
+		{
+			delta_feature[j] /= denominator;
+		}
+	}
 }
@@ -0,0 +1,108 @@
+#include "fft.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+FFT::FFT(int n) :
+	n(round_size(n)), bit_reversal(setup_bit_reversal(round_size(n))), twiddles(setup_twiddles(round_size(n)))
+{
+}
+
+int FFT::round_size(int n)
+{
+	int size = 4;
+
+	while (size < n)
+	{
+		size <<= 1;
+	}
+
+	return size;
+}
+
+void FFT::transform(const vector<double> &x, vector<complex<double>> &X) const
+{
+	const int M = n / 2, size = min((int)x.size(), n);
+	X.resize(M + 1);
+
+	// pack even and odd samples as a half size complex sequence
+	for (int i = 0; i < M; ++i)
+	{
+		const double real = 2 * i < size ? x[2 * i] : 0.0;
+		const double imag = 2 * i + 1 < size ? x[2 * i + 1] : 0.0;
+		X[bit_reversal[i]] = complex<double>(real, imag);
+	}
+	fft(X);
+	split(X);
+}
+
+vector<int> FFT::setup_bit_reversal(int n)
+{
+	const int M = n / 2;
+	vector<int> bit_reversal(M, 0);
+
+	for (int i = 1, j = 0; i < M; ++i)
+	{
+		int bit = M >> 1;
+		for (; j & bit; bit >>= 1)
+		{
+			j ^= bit;
+		}
+		j ^= bit;
+		bit_reversal[i] = j;
+	}
+
+	return bit_reversal;
+}
+
+vector<complex<double>> FFT::setup_twiddles(int n)
+{
+	vector<complex<double>> twiddles(n / 2, complex<double>());
+
+	// computed directly so that errors do not accumulate
+	const double pi = 4.0 * atan(1.0);
+	for (int i = 0; i < n / 2; ++i)
+	{
+		twiddles[i] = polar(1.0, -2.0 * pi * i / n);
+	}
+
+	return twiddles;
+}
+
+void FFT::fft(vector<complex<double>> &z) const
+{
+	const int M = n / 2;
+
+	for (int length = 2; length <= M; length <<= 1)
+	{
+		const int half = length / 2, step = n / length;
+		for (int i = 0; i < M; i += length)
+		{
+			for (int j = 0; j < half; ++j)
+			{
+				const complex<double> t = z[i + j + half] * twiddles[j * step];
+				z[i + j + half] = z[i + j] - t;
+				z[i + j] += t;
+			}
+		}
+	}
+}
+
+void FFT::split(vector<complex<double>> &X) const
+{
+	const int M = n / 2;
+	const complex<double> half_i(0.0, 0.5);
+
+	for (int k = 1; k <= M / 2; ++k)
+	{
+		const complex<double> Z_k = X[k], Z_m = X[M - k];
+		X[k] = 0.5 * (Z_k + conj(Z_m)) - half_i * twiddles[k] * (Z_k - conj(Z_m));
+		X[M - k] = 0.5 * (Z_m + conj(Z_k)) + half_i * conj(twiddles[k]) * (Z_m - conj(Z_k));
+	}
+
+	const double real = X[0].real(), imag = X[0].imag();
+	X[0] = complex<double>(real + imag, 0.0);
+	X[M] = complex<double>(real - imag, 0.0);
+}
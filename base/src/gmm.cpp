@@ -0,0 +1,215 @@
+#include "gmm.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "cpu.h"
+
+using namespace std;
+
+GMM::GMM() :
+	n_states(0), n_mixtures(0), n_padded(0), means(), precisions(), constants(), kernel(&GMM::scalar_kernel)
+{
+}
+
+GMM::GMM(const Model &lambda) :
+	GMM(lambda.b, lambda.means, lambda.variances)
+{
+}
+
+GMM::GMM(const Matrix<double> &weights, const Matrix<double> &means, const Matrix<double> &variances) :
+	n_states(weights.rows()), n_mixtures(weights.cols()), n_padded((means.rows() + x_lanes - 1) / x_lanes * x_lanes),
+	means(setup_table(means, (means.rows() + x_lanes - 1) / x_lanes * x_lanes, false)),
+	precisions(setup_table(variances, (variances.rows() + x_lanes - 1) / x_lanes * x_lanes, true)),
+	constants(setup_constants(weights, variances, (variances.rows() + x_lanes - 1) / x_lanes * x_lanes)), kernel(setup_kernel())
+{
+}
+
+Matrix<double> GMM::components(const Features &features) const
+{
+	const int T = features.rows();
+	Matrix<double> log_likelihoods(T, n_padded, 0.0);
+
+	for (int i = 0; i < T; i += x_block)
+	{
+		// the last block repeats its last feature
+		const int n_x = min(x_block, T - i);
+		const double *x[x_block];
+		double *y[x_block];
+		for (int f = 0; f < x_block; ++f)
+		{
+			x[f] = features[i + min(f, n_x - 1)];
+			y[f] = log_likelihoods[i + min(f, n_x - 1)];
+		}
+		kernel(x, means[0], precisions[0], constants.data(), means.rows(), n_padded, y);
+	}
+
+	return log_likelihoods;
+}
+
+/// Mixtures are summed relative to the best one, so that unlikely features do not underflow.
+Matrix<double> GMM::states(const Matrix<double> &components) const
+{
+	const int T = components.rows();
+	Matrix<double> log_likelihoods(T, n_states, 0.0);
+
+	for (int t = 0; t < T; ++t)
+	{
+		for (int i = 0; i < n_states; ++i)
+		{
+			const double *mixtures = components[t] + i * n_mixtures;
+			const double max_mixture = *max_element(mixtures, mixtures + n_mixtures);
+			if (max_mixture == -numeric_limits<double>::infinity())
+			{
+				log_likelihoods[t][i] = max_mixture;
+				continue;
+			}
+
+			double sum = 0.0;
+			for (int k = 0; k < n_mixtures; ++k)
+			{
+				sum += exp(mixtures[k] - max_mixture);
+			}
+			log_likelihoods[t][i] = max_mixture + log(sum);
+		}
+	}
+
+	return log_likelihoods;
+}
+
+Densities GMM::top(const Features &features, int n_top) const
+{
+	const int T = features.rows(), n_components = n_states * n_mixtures;
+	n_top = min(n_top, n_components);
+	Densities densities{ Matrix<int>(T, n_top, 0), Matrix<double>(T, n_top, 0.0), vector<double>(T, 0.0) };
+
+	const Matrix<double> log_likelihoods = components(features);
+	vector<int> indices(n_components, 0);
+	for (int t = 0; t < T; ++t)
+	{
+		const double *log_likelihood = log_likelihoods[t];
+		for (int c = 0; c < n_components; ++c)
+		{
+			indices[c] = c;
+		}
+		partial_sort(indices.begin(), indices.begin() + n_top, indices.end(), [log_likelihood](int a, int b) { return log_likelihood[a] > log_likelihood[b]; });
+
+		densities.log_scales[t] = log_likelihood[indices[0]];
+		for (int k = 0; k < n_top; ++k)
+		{
+			densities.indices[t][k] = indices[k];
+			densities.likelihoods[t][k] = exp(log_likelihood[indices[k]] - densities.log_scales[t]);
+		}
+	}
+
+	return densities;
+}
+
+/// Padded components have zero means and precisions, and are never looked at.
+Matrix<double> GMM::setup_table(const Matrix<double> &values, int n_padded, bool q_inverse)
+{
+	Matrix<double> table(values.cols(), n_padded, 0.0);
+
+	for (int i = 0; i < values.rows(); ++i)
+	{
+		for (int j = 0; j < values.cols(); ++j)
+		{
+			table[j][i] = q_inverse ? 1 / values[i][j] : values[i][j];
+		}
+	}
+
+	return table;
+}
+
+vector<double> GMM::setup_constants(const Matrix<double> &weights, const Matrix<double> &variances, int n_padded)
+{
+	vector<double> constants(n_padded, 0.0);
+
+	const double pi = 4.0 * atan(1.0);
+	const int K = weights.cols(), D = variances.cols();
+	for (int c = 0; c < variances.rows(); ++c)
+	{
+		double log_determinant = 0.0;
+		for (int d = 0; d < D; ++d)
+		{
+			log_determinant += log(variances[c][d]);
+		}
+		constants[c] = log(weights[c / K][c % K]) - 0.5 * (D * log(2 * pi) + log_determinant);
+	}
+
+	return constants;
+}
+
+GMM::Kernel GMM::setup_kernel()
+{
+	if (CPU::avx2())
+	{
+		return &GMM::avx2_kernel;
+	}
+
+	return &GMM::scalar_kernel;
+}
+
+void GMM::scalar_kernel(const double *const *x, const double *means, const double *precisions, const double *constants, int n_dims, int n_padded, double *const *log_likelihoods)
+{
+	for (int f = 0; f < x_block; ++f)
+	{
+		double *y = log_likelihoods[f];
+		for (int c = 0; c < n_padded; ++c)
+		{
+			y[c] = 0.0;
+		}
+		for (int d = 0; d < n_dims; ++d)
+		{
+			const double x_d = x[f][d];
+			const double *mean = means + d * n_padded, *precision = precisions + d * n_padded;
+			for (int c = 0; c < n_padded; ++c)
+			{
+				const double difference = x_d - mean[c];
+				y[c] += difference * difference * precision[c];
+			}
+		}
+		for (int c = 0; c < n_padded; ++c)
+		{
+			y[c] = constants[c] - 0.5 * y[c];
+		}
+	}
+}
+
+#ifdef SR_LIB_X86
+/// Products are added without fusing and in the order of the scalar kernel, so that the likelihoods are the same whichever kernel is chosen.
+SR_LIB_TARGET("avx2")
+void GMM::avx2_kernel(const double *const *x, const double *means, const double *precisions, const double *constants, int n_dims, int n_padded, double *const *log_likelihoods)
+{
+	const __m256d half = _mm256_set1_pd(0.5);
+	for (int c = 0; c < n_padded; c += 4)
+	{
+		__m256d acc[x_block];
+		for (int f = 0; f < x_block; ++f)
+		{
+			acc[f] = _mm256_setzero_pd();
+		}
+		for (int d = 0; d < n_dims; ++d)
+		{
+			const __m256d mean = _mm256_loadu_pd(means + d * n_padded + c);
+			const __m256d precision = _mm256_loadu_pd(precisions + d * n_padded + c);
+			for (int f = 0; f < x_block; ++f)
+			{
+				const __m256d difference = _mm256_sub_pd(_mm256_set1_pd(x[f][d]), mean);
+				acc[f] = _mm256_add_pd(acc[f], _mm256_mul_pd(_mm256_mul_pd(difference, difference), precision));
+			}
+		}
+		const __m256d constant = _mm256_loadu_pd(constants + c);
+		for (int f = 0; f < x_block; ++f)
+		{
+			_mm256_storeu_pd(log_likelihoods[f] + c, _mm256_sub_pd(constant, _mm256_mul_pd(half, acc[f])));
+		}
+	}
+}
+#else
+void GMM::avx2_kernel(const double *const *x, const double *means, const double *precisions, const double *constants, int n_dims, int n_padded, double *const *log_likelihoods)
+{
+	scalar_kernel(x, means, precisions, constants, n_dims, n_padded, log_likelihoods);
+}
+#endif
@@ -2,80 +2,248 @@
 
 #include <algorithm>
 #include <cmath>
+#include <future>
+#include <limits>
 
 using namespace std;
 
-HMM::HMM(const Model &lambda) :
-	lambda(lambda)
+HMM::HMM(const Model &lambda, bool q_band) :
+	q_band(q_band), lambda(lambda), gmm()
 {
+	setup();
 }
 
 Model HMM::optimise(const vector<int> &o)
 {
-	int iteration = 0;
-	double old_P_star, P_star;
+	return optimise(vector<vector<int>>{ o }, nullptr);
+}
 
-	tweak();
-	P_star = viterbi(o).first;
-	do
+Model HMM::optimise(const vector<vector<int>> &os, ThreadPool *thread_pool)
+{
+	return optimise(os.size(), [this, &os](int q) { return expect(os[q]); }, thread_pool);
+}
+
+Model HMM::optimise(const vector<Features> &xs, ThreadPool *thread_pool)
+{
+	return optimise(xs.size(), [this, &xs](int q) { return expect(xs[q]); }, thread_pool);
+}
+
+Model HMM::optimise(const vector<Densities> &densities, ThreadPool *thread_pool)
+{
+	return optimise(densities.size(), [this, &densities](int q) { return expect(densities[q]); }, thread_pool);
+}
+
+pair<double, Matrix<double>> HMM::forward(const vector<int> &o) const
+{
+	const int N = lambda.b.rows(), T = o.size();
+	pair<double, Matrix<double>> alpha(0.0, Matrix<double>(T, N, 0.0));
+
+	for (int t = 0; t < T; ++t)
 	{
-		iteration += 1;
-		old_P_star = P_star;
+		alpha.first += t == 0 ? forward_start(bt[o[t]], alpha.second[t]) : forward_step(alpha.second[t - 1], bt[o[t]], alpha.second[t]);
+	}
 
-		restimate(o);
-		tweak();
-		P_star = viterbi(o).first;
-	} while (P_star / old_P_star > convergence_threshold && iteration < convergence_max_iterations);
+	return alpha;
+}
 
-	return lambda;
+/// Only two rows of alpha are kept, they take turns in the workspace.
+double HMM::score(const vector<int> &o, vector<double> &workspace) const
+{
+	const int N = lambda.b.rows(), T = o.size();
+
+	workspace.resize(2 * N);
+	double *alpha = workspace.data(), *alpha_next = workspace.data() + N;
+	double log_P = T == 0 ? 0.0 : forward_start(bt[o[0]], alpha);
+	for (int t = 1; t < T; ++t)
+	{
+		log_P += forward_step(alpha, bt[o[t]], alpha_next);
+		swap(alpha, alpha_next);
+	}
+
+	return log_P;
+}
+
+double HMM::score(const Features &x, vector<double> &workspace) const
+{
+	return score(emissions(x), workspace);
 }
 
-pair<double, vector<vector<double>>> HMM::forward(const vector<int> &o) const
+double HMM::score(const Densities &densities, vector<double> &workspace) const
 {
-	const int M = lambda.b[0].size(), N = lambda.b.size(), T = o.size();
-	pair<double, vector<vector<double>>> alpha(0.0, vector<vector<double>>(T, vector<double>(N, 0.0)));
+	return score(emissions(densities), workspace);
+}
 
-	vector<double> C(T, 0.0);
-	for (int i = 0; i < N; ++i)
+/// Likelihoods of features are mostly far below one, so the scales of the emissions are added back to the log likelihood.
+double HMM::score(const pair<vector<double>, Matrix<double>> &b, vector<double> &workspace) const
+{
+	const int N = lambda.b.rows(), T = b.second.rows();
+
+	workspace.resize(2 * N);
+	double *alpha = workspace.data(), *alpha_next = workspace.data() + N;
+	double log_P = T == 0 ? 0.0 : forward_start(b.second[0], alpha) + b.first[0];
+	for (int t = 1; t < T; ++t)
 	{
-		alpha.second[0][i] = lambda.pi[i] * lambda.b[i][o[0]];
-		C[0] += alpha.second[0][i];
+		log_P += forward_step(alpha, b.second[t], alpha_next) + b.first[t];
+		swap(alpha, alpha_next);
 	}
-	C[0] = 1 / C[0];
+
+	return log_P;
+}
+
+double HMM::forward_step(vector<double> &alpha, int o, vector<double> &new_alpha) const
+{
+	return forward_step(alpha, bt[o], new_alpha);
+}
+
+double HMM::forward_step(vector<double> &alpha, const double *b, vector<double> &new_alpha) const
+{
+	const int N = lambda.b.rows();
+
+	new_alpha.resize(N);
+	const double log_C = alpha.empty() ? forward_start(b, new_alpha.data()) : forward_step(alpha.data(), b, new_alpha.data());
+	alpha.swap(new_alpha);
+
+	return log_C;
+}
+
+double HMM::viterbi_step(const vector<double> &delta, double entry, int o, vector<double> &new_delta, vector<int> &sources) const
+{
+	return viterbi_step(delta, entry, log_bt[o], new_delta, sources);
+}
+
+/// An empty delta has no tokens, pruned states are skipped as sources.
+double HMM::viterbi_step(const vector<double> &delta, double entry, const double *log_b, vector<double> &new_delta, vector<int> &sources) const
+{
+	const int N = lambda.b.rows();
+
+	double max_delta = -numeric_limits<double>::infinity();
+	new_delta.resize(N);
+	sources.resize(N);
 	for (int i = 0; i < N; ++i)
 	{
-		alpha.second[0][i] *= C[0];
+		double max_source = entry + log_pi[i];
+		int source = -1;
+		if (!delta.empty())
+		{
+			const double *log_a = log_at[i];
+			for (int j = at_bands[i].first; j < at_bands[i].second; ++j)
+			{
+				if (delta[j] != -numeric_limits<double>::infinity() && max_source < delta[j] + log_a[j])
+				{
+					max_source = delta[j] + log_a[j];
+					source = j;
+				}
+			}
+		}
+		new_delta[i] = max_source + log_b[i];
+		sources[i] = source;
+		max_delta = max(max_delta, new_delta[i]);
 	}
-	for (int t = 0; t < T - 1; ++t)
+
+	return max_delta;
+}
+
+const double *HMM::log_emissions(int o) const
+{
+	return log_bt[o];
+}
+
+Matrix<double> HMM::log_emissions(const Features &x) const
+{
+	return gmm.states(gmm.components(x));
+}
+
+Matrix<double> HMM::log_emissions(const Densities &densities) const
+{
+	return logarithm(emissions(densities));
+}
+
+pair<vector<double>, Matrix<double>> HMM::emissions(const Features &x) const
+{
+	return exponentiate(log_emissions(x));
+}
+
+/// Gaussians outside the most likely ones are taken as zero.
+pair<vector<double>, Matrix<double>> HMM::emissions(const Densities &densities) const
+{
+	const int N = lambda.b.rows(), T = densities.indices.rows(), K = densities.indices.cols();
+	pair<vector<double>, Matrix<double>> b(densities.log_scales, Matrix<double>(T, N, 0.0));
+
+	for (int t = 0; t < T; ++t)
 	{
-		for (int i = 0; i < N; ++i)
+		double *b_t = b.second[t];
+		for (int k = 0; k < K; ++k)
 		{
-			for (int j = 0; j < N; ++j)
+			const double likelihood = densities.likelihoods[t][k];
+			const double *b_k = bt[densities.indices[t][k]];
+			for (int i = 0; i < N; ++i)
 			{
-				alpha.second[t + 1][i] += alpha.second[t][j] * lambda.a[j][i];
+				b_t[i] += likelihood * b_k[i];
 			}
-			alpha.second[t + 1][i] *= lambda.b[i][o[t + 1]];
-			C[t + 1] += alpha.second[t + 1][i];
 		}
-		C[t + 1] = 1 / C[t + 1];
+	}
+
+	return b;
+}
+
+/// Log tables are taken after tweaking, zero initial probabilities are raised to minimum probability.
+void HMM::setup()
+{
+	const int M = lambda.b.cols(), N = lambda.b.rows();
+
+	at = lambda.a.transpose();
+	bt = lambda.b.transpose();
+	a_bands = setup_bands(lambda.a);
+	at_bands = setup_bands(at);
+	log_at = Matrix<double>(N, N);
+	log_bt = Matrix<double>(M, N);
+	log_pi = vector<double>(N, 0.0);
+	for (int i = 0; i < N; ++i)
+	{
+		for (int j = 0; j < N; ++j)
+		{
+			log_at[i][j] = log(at[i][j]);
+		}
+		log_pi[i] = log(lambda.pi[i] == 0.0 ? minimum_probability : lambda.pi[i]);
+	}
+	for (int k = 0; k < M; ++k)
+	{
 		for (int i = 0; i < N; ++i)
 		{
-			alpha.second[t + 1][i] *= C[t + 1];
+			log_bt[k][i] = log(bt[k][i]);
 		}
 	}
+	if (lambda.continuous())
+	{
+		gmm = GMM(lambda);
+	}
+}
 
-	for (int t = 0; t < T; ++t)
+vector<pair<int, int>> HMM::setup_bands(const Matrix<double> &matrix)
+{
+	vector<pair<int, int>> bands(matrix.rows(), pair<int, int>(0, 0));
+
+	for (int i = 0; i < matrix.rows(); ++i)
 	{
-		alpha.first -= log(C[t]);
+		int first = 0, last = matrix.cols() - 1;
+		while (first < matrix.cols() && matrix[i][first] == 0.0)
+		{
+			first++;
+		}
+		while (last > first && matrix[i][last] == 0.0)
+		{
+			last--;
+		}
+		bands[i] = first < matrix.cols() ? pair<int, int>(first, last + 1) : pair<int, int>(0, 0);
 	}
 
-	return alpha;
+	return bands;
 }
 
-/// Forcibly set all zeroes in the model to minimum probability.
+/// Forcibly set all zeroes in the model to minimum probability, zero transitions outside the band are kept if banded.
 void HMM::tweak()
 {
-	const int M = lambda.b[0].size(), N = lambda.b.size();
+	const int M = lambda.b.cols(), N = lambda.b.rows();
 
 	for (int i = 0; i < N; ++i)
 	{
@@ -87,8 +255,9 @@ void HMM::tweak()
 				dummy = min(dummy, lambda.a[i][j] / 10.0);
 			}
 		}
+		const pair<int, int> band = q_band ? a_bands[i] : pair<int, int>(0, N);
 		int count = 0;
-		for (int j = 0; j < N; ++j)
+		for (int j = band.first; j < band.second; ++j)
 		{
 			if (lambda.a[i][j] == 0.0)
 			{
@@ -138,56 +307,163 @@ void HMM::tweak()
 	}
 }
 
-pair<double, vector<int>> HMM::viterbi(const vector<int> &o) const
+double HMM::forward_start(const double *b, double *alpha) const
 {
-	const int M = lambda.b[0].size(), N = lambda.b.size(), T = o.size();
-	pair<double, vector<int>> q(0.0, vector<int>(T, 0));
+	const int N = lambda.b.rows();
 
-	vector<int> psi(T, 0);
-	vector<vector<double>> delta(T, vector<double>(N, 0.0));
+	double C = 0.0;
 	for (int i = 0; i < N; ++i)
 	{
-		double temp = lambda.pi[i];
-		if (temp == 0.0)
+		alpha[i] = lambda.pi[i] * b[i];
+		C += alpha[i];
+	}
+	scale(alpha, C);
+
+	return log(C);
+}
+
+double HMM::forward_step(const double *alpha, const double *b, double *alpha_next) const
+{
+	const int N = lambda.b.rows();
+
+	double C = 0.0;
+	for (int i = 0; i < N; ++i)
+	{
+		const double *a = at[i];
+		double sum = 0.0;
+		for (int j = at_bands[i].first; j < at_bands[i].second; ++j)
+		{
+			sum += alpha[j] * a[j];
+		}
+		alpha_next[i] = sum * b[i];
+		C += alpha_next[i];
+	}
+	scale(alpha_next, C);
+
+	return log(C);
+}
+
+void HMM::scale(double *alpha, double C) const
+{
+	const int N = lambda.b.rows();
+
+	C = 1 / C;
+	for (int i = 0; i < N; ++i)
+	{
+		alpha[i] *= C;
+	}
+}
+
+pair<vector<double>, Matrix<double>> HMM::exponentiate(const Matrix<double> &log_b)
+{
+	const int T = log_b.rows(), N = log_b.cols();
+	pair<vector<double>, Matrix<double>> b(vector<double>(T, 0.0), Matrix<double>(T, N, 0.0));
+
+	for (int t = 0; t < T; ++t)
+	{
+		b.first[t] = *max_element(log_b[t], log_b[t] + N);
+		for (int i = 0; i < N; ++i)
+		{
+			b.second[t][i] = exp(log_b[t][i] - b.first[t]);
+		}
+	}
+
+	return b;
+}
+
+Matrix<double> HMM::logarithm(const pair<vector<double>, Matrix<double>> &b)
+{
+	const int T = b.second.rows(), N = b.second.cols();
+	Matrix<double> log_b(T, N, 0.0);
+
+	for (int t = 0; t < T; ++t)
+	{
+		for (int i = 0; i < N; ++i)
 		{
-			temp = minimum_probability;
+			log_b[t][i] = log(b.second[t][i]) + b.first[t];
 		}
-		delta[0][i] = log(temp) + log(lambda.b[i][o[0]]);
+	}
+
+	return log_b;
+}
+
+Matrix<double> HMM::emissions(const vector<int> &o) const
+{
+	const int N = lambda.b.rows(), T = o.size();
+	Matrix<double> b(T, N, 0.0);
+
+	for (int t = 0; t < T; ++t)
+	{
+		copy(bt[o[t]], bt[o[t]] + N, b[t]);
+	}
+
+	return b;
+}
+
+pair<double, vector<int>> HMM::viterbi(const vector<int> &o) const
+{
+	const int N = lambda.b.rows(), T = o.size();
+	pair<double, vector<int>> q(0.0, vector<int>(T, 0));
+
+	Matrix<int> psi(T, N, 0);
+	Matrix<double> delta(T, N, 0.0);
+	for (int i = 0; i < N; ++i)
+	{
+		delta[0][i] = log_pi[i] + log_bt[o[0]][i];
 	}
 	for (int t = 0; t < T - 1; ++t)
 	{
+		const double *delta_t = delta[t];
+		const double *log_b = log_bt[o[t + 1]];
 		for (int i = 0; i < N; ++i)
 		{
-			delta[t + 1][i] = numeric_limits<double>::min();
-			for (int j = 0; j < N; ++j)
+			const double *log_a = log_at[i];
+			double max_delta = -numeric_limits<double>::infinity();
+			int max_j = 0;
+			for (int j = at_bands[i].first; j < at_bands[i].second; ++j)
 			{
-				double current_max_delta = delta[t][j] + log(lambda.a[j][i]);
-				if (delta[t + 1][i] < current_max_delta)
+				const double current_delta = delta_t[j] + log_a[j];
+				if (max_delta < current_delta)
 				{
-					delta[t + 1][i] = current_max_delta;
-					psi[i] = j;
+					max_delta = current_delta;
+					max_j = j;
 				}
 			}
-			delta[t + 1][i] += lambda.b[i][o[t + 1]];
+			delta[t + 1][i] = max_delta + log_b[i];
+			psi[t + 1][i] = max_j;
 		}
 	}
 
-	q.second[T - 1] = max_element(delta[T - 1].begin(), delta[T - 1].end()) - delta[T - 1].begin();
+	q.second[T - 1] = max_element(delta[T - 1], delta[T - 1] + N) - delta[T - 1];
 	q.first = delta[T - 1][q.second[T - 1]];
-	for (int i = T - 2; i >= 0; --i)
+	for (int t = T - 2; t >= 0; --t)
 	{
-		q.second[i] = psi[q.second[i + 1]];
+		q.second[t] = psi[t + 1][q.second[t + 1]];
 	}
 
 	return q;
 }
 
-vector<vector<double>> HMM::backward(const vector<int> &o) const
+pair<double, Matrix<double>> HMM::forward(const Matrix<double> &b) const
 {
-	const int M = lambda.b[0].size(), N = lambda.b.size(), T = o.size();
-	vector<vector<double>> beta(T, vector<double>(N, 0.0));
+	const int N = lambda.b.rows(), T = b.rows();
+	pair<double, Matrix<double>> alpha(0.0, Matrix<double>(T, N, 0.0));
 
-	vector<double> C(T, 0.0);
+	for (int t = 0; t < T; ++t)
+	{
+		alpha.first += t == 0 ? forward_start(b[t], alpha.second[t]) : forward_step(alpha.second[t - 1], b[t], alpha.second[t]);
+	}
+
+	return alpha;
+}
+
+/// Emissions are folded into beta first, so that the sum runs along a row of a.
+Matrix<double> HMM::backward(const Matrix<double> &b) const
+{
+	const int N = lambda.b.rows(), T = b.rows();
+	Matrix<double> beta(T, N, 0.0);
+
+	vector<double> C(T, 0.0), weighted_beta(N, 0.0);
 	for (int i = 0; i < N; ++i)
 	{
 		beta[T - 1][i] = 1;
@@ -200,12 +476,20 @@ vector<vector<double>> HMM::backward(const vector<int> &o) const
 	}
 	for (int t = T - 2; t >= 0; --t)
 	{
+		const double *b_next = b[t + 1];
+		for (int j = 0; j < N; ++j)
+		{
+			weighted_beta[j] = beta[t + 1][j] * b_next[j];
+		}
 		for (int i = 0; i < N; ++i)
 		{
-			for (int j = 0; j < N; ++j)
+			const double *a = lambda.a[i];
+			double sum = 0.0;
+			for (int j = a_bands[i].first; j < a_bands[i].second; ++j)
 			{
-				beta[t][i] += beta[t + 1][j] * lambda.a[i][j] * lambda.b[j][o[t + 1]];
+				sum += a[j] * weighted_beta[j];
 			}
+			beta[t][i] = sum;
 			C[t + 1] += beta[t][i];
 		}
 		C[t + 1] = 1 / C[t + 1];
@@ -218,86 +502,285 @@ vector<vector<double>> HMM::backward(const vector<int> &o) const
 	return beta;
 }
 
-void HMM::restimate(const vector<int> &o)
+HMM::Statistics HMM::zero_statistics() const
 {
-	const int M = lambda.b[0].size(), N = lambda.b.size(), T = o.size();
+	const int M = lambda.b.cols(), N = lambda.b.rows(), D = lambda.means.cols();
+	Statistics statistics{ 0.0, 0, Matrix<double>(N, N, 0.0), Matrix<double>(N, M, 0.0), vector<double>(N, 0.0), vector<double>(N, 0.0), Matrix<double>(), Matrix<double>() };
 
-	const vector<vector<double>> alpha = forward(o).second;
-	const vector<vector<double>> beta = backward(o);
-	vector<vector<vector<double>>> xsi(T, vector<vector<double>>(N, vector<double>(N, 0.0)));
-	for (int t = 0; t < T - 1; ++t)
+	if (lambda.continuous())
 	{
+		statistics.x_numerator = Matrix<double>(N * M, D, 0.0);
+		statistics.xx_numerator = Matrix<double>(N * M, D, 0.0);
+	}
+
+	return statistics;
+}
+
+/// Transition statistics are accumulated per time step, so only alpha, beta and gamma are kept for all time steps.
+Matrix<double> HMM::expect(const Matrix<double> &b, Statistics &statistics) const
+{
+	const int N = lambda.b.rows(), T = b.rows();
+	Matrix<double> gamma(T, N, 0.0);
+
+	const pair<double, Matrix<double>> alpha = forward(b);
+	const Matrix<double> beta = backward(b);
+	statistics.log_P += alpha.first;
+	statistics.n_observations += T;
+	vector<double> weighted_beta(N, 0.0);
+	for (int t = 0; t < T; ++t)
+	{
+		// gamma is the normalised product of alpha and beta, their scales cancel out
 		double denominator = 0.0;
 		for (int i = 0; i < N; ++i)
 		{
-			for (int j = 0; j < N; ++j)
+			gamma[t][i] = alpha.second[t][i] * beta[t][i];
+			denominator += gamma[t][i];
+		}
+		for (int i = 0; i < N; ++i)
+		{
+			gamma[t][i] /= denominator;
+		}
+		if (t == T - 1)
+		{
+			break;
+		}
+
+		// xsi of the time step is alpha[t][i] * a[i][j] * b[j][t + 1] * beta[t + 1][j], normalised
+		const double *b_next = b[t + 1];
+		for (int j = 0; j < N; ++j)
+		{
+			weighted_beta[j] = b_next[j] * beta[t + 1][j];
+		}
+		denominator = 0.0;
+		for (int i = 0; i < N; ++i)
+		{
+			const double *a = lambda.a[i];
+			for (int j = a_bands[i].first; j < a_bands[i].second; ++j)
 			{
-				denominator += alpha[t][i] * lambda.a[i][j] * lambda.b[j][o[t + 1]] * beta[t + 1][j];
+				denominator += alpha.second[t][i] * a[j] * weighted_beta[j];
 			}
 		}
 		for (int i = 0; i < N; ++i)
 		{
-			for (int j = 0; j < N; ++j)
+			const double *a = lambda.a[i];
+			double *a_sum = statistics.a_numerator[i];
+			const double scale = alpha.second[t][i] / denominator;
+			for (int j = a_bands[i].first; j < a_bands[i].second; ++j)
 			{
-				double numerator = alpha[t][i] * lambda.a[i][j] * lambda.b[j][o[t + 1]] * beta[t + 1][j];
-				xsi[t][i][j] = numerator / denominator;
+				a_sum[j] += scale * a[j] * weighted_beta[j];
 			}
 		}
 	}
+	for (int i = 0; i < N && T > 0; ++i)
+	{
+		statistics.pi[i] = gamma[0][i];
+	}
+
+	return gamma;
+}
+
+HMM::Statistics HMM::expect(const vector<int> &o) const
+{
+	const int N = lambda.b.rows(), T = o.size();
+	Statistics statistics = zero_statistics();
+
+	const Matrix<double> gamma = expect(emissions(o), statistics);
+	for (int t = 0; t < T - 1; ++t)
+	{
+		// emissions are counted over the same time steps as the transitions
+		for (int i = 0; i < N; ++i)
+		{
+			statistics.b_numerator[i][o[t]] += gamma[t][i];
+			statistics.b_denominator[i] += gamma[t][i];
+		}
+	}
 
-	vector<vector<double>> gamma(T, vector<double>(N, 0.0));
+	return statistics;
+}
+
+/// Components are evaluated once for the sequence, the share of a component in its state comes from the same likelihoods.
+HMM::Statistics HMM::expect(const Features &x) const
+{
+	const int M = lambda.b.cols(), N = lambda.b.rows(), D = x.cols(), T = x.rows();
+	Statistics statistics = zero_statistics();
+
+	const Matrix<double> components = gmm.components(x);
+	const Matrix<double> log_b = gmm.states(components);
+	const pair<vector<double>, Matrix<double>> b = exponentiate(log_b);
+	const Matrix<double> gamma = expect(b.second, statistics);
 	for (int t = 0; t < T; ++t)
 	{
+		statistics.log_P += b.first[t];
 		for (int i = 0; i < N; ++i)
 		{
-			for (int j = 0; j < N; ++j)
+			if (gamma[t][i] == 0.0)
+			{
+				continue;
+			}
+
+			statistics.b_denominator[i] += gamma[t][i];
+			for (int k = 0; k < M; ++k)
 			{
-				gamma[t][i] += xsi[t][i][j];
+				const int c = i * M + k;
+				const double share = gamma[t][i] * exp(components[t][c] - log_b[t][i]);
+				double *x_sum = statistics.x_numerator[c], *xx_sum = statistics.xx_numerator[c];
+				statistics.b_numerator[i][k] += share;
+				for (int d = 0; d < D; ++d)
+				{
+					x_sum[d] += share * x[t][d];
+					xx_sum[d] += share * x[t][d] * x[t][d];
+				}
 			}
 		}
 	}
 
-	for (int i = 0; i < N; ++i)
+	return statistics;
+}
+
+/// The share of a gaussian in the emission of a state comes from the same mixed likelihoods.
+HMM::Statistics HMM::expect(const Densities &densities) const
+{
+	const int N = lambda.b.rows(), T = densities.indices.rows(), K = densities.indices.cols();
+	Statistics statistics = zero_statistics();
+
+	const pair<vector<double>, Matrix<double>> b = emissions(densities);
+	const Matrix<double> gamma = expect(b.second, statistics);
+	for (int t = 0; t < T; ++t)
 	{
-		double denominator = 0.0;
-		for (int t = 0; t < T; ++t)
-		{
-			denominator += gamma[t][i];
-		}
-		for (int j = 0; j < N; ++j)
+		statistics.log_P += b.first[t];
+		for (int i = 0; i < N; ++i)
 		{
-			double numerator = 0.0;
-			for (int t = 0; t < T; ++t)
+			if (gamma[t][i] == 0.0)
 			{
-				numerator += xsi[t][i][j];
+				continue;
+			}
+
+			statistics.b_denominator[i] += gamma[t][i];
+			const double scale = gamma[t][i] / b.second[t][i];
+			for (int k = 0; k < K; ++k)
+			{
+				const int symbol = densities.indices[t][k];
+				statistics.b_numerator[i][symbol] += scale * densities.likelihoods[t][k] * lambda.b[i][symbol];
 			}
-			lambda.a[i][j] = numerator / denominator;
 		}
 	}
 
-	for (int i = 0; i < N; ++i)
+	return statistics;
+}
+
+/// Sequences are summed in their order, so the result does not depend on the number of threads.
+HMM::Statistics HMM::expect_all(int n_sequences, const function<Statistics(int)> &expect_sequence, ThreadPool *thread_pool) const
+{
+	const int M = lambda.b.cols(), N = lambda.b.rows();
+	Statistics statistics = zero_statistics();
+
+	vector<future<Statistics>> statistics_futures;
+	for (int q = 0; q < n_sequences && thread_pool != nullptr; ++q)
 	{
-		double denominator = 0.0;
-		for (int t = 0; t < T; ++t)
+		statistics_futures.push_back(thread_pool->enqueue(expect_sequence, q));
+	}
+	for (int q = 0; q < n_sequences; ++q)
+	{
+		const Statistics sequence_statistics = thread_pool != nullptr ? statistics_futures[q].get() : expect_sequence(q);
+		statistics.log_P += sequence_statistics.log_P;
+		statistics.n_observations += sequence_statistics.n_observations;
+		for (int i = 0; i < N; ++i)
 		{
-			denominator += gamma[t][i];
+			for (int j = 0; j < N; ++j)
+			{
+				statistics.a_numerator[i][j] += sequence_statistics.a_numerator[i][j];
+			}
+			for (int k = 0; k < M; ++k)
+			{
+				statistics.b_numerator[i][k] += sequence_statistics.b_numerator[i][k];
+			}
+			statistics.b_denominator[i] += sequence_statistics.b_denominator[i];
+			statistics.pi[i] += sequence_statistics.pi[i];
 		}
-		for (int j = 0; j < M; ++j)
+		for (int c = 0; c < statistics.x_numerator.rows(); ++c)
 		{
-			double numerator = 0.0;
-			for (int t = 0; t < T; ++t)
+			for (int d = 0; d < statistics.x_numerator.cols(); ++d)
 			{
-				if (o[t] == j)
-				{
-					numerator += gamma[t][i];
-				}
+				statistics.x_numerator[c][d] += sequence_statistics.x_numerator[c][d];
+				statistics.xx_numerator[c][d] += sequence_statistics.xx_numerator[c][d];
 			}
-			lambda.b[i][j] = numerator / denominator;
 		}
 	}
 
+	return statistics;
+}
+
+/// Likelihood of the observations comes along with the expected counts, so it is judged before each maximisation.
+/// The gain is taken per observation, so that words with more utterances do not need more iterations.
+Model HMM::optimise(int n_sequences, const function<Statistics(int)> &expect_sequence, ThreadPool *thread_pool)
+{
+	int iteration = 0;
+	double old_log_P;
+
+	tweak();
+	setup();
+	Statistics statistics = expect_all(n_sequences, expect_sequence, thread_pool);
+	do
+	{
+		iteration += 1;
+		old_log_P = statistics.log_P;
+
+		maximise(statistics);
+		tweak();
+		setup();
+		statistics = expect_all(n_sequences, expect_sequence, thread_pool);
+	} while ((statistics.log_P - old_log_P) / max(statistics.n_observations, 1) > log(convergence_threshold) && iteration < convergence_max_iterations);
+
+	return lambda;
+}
+
+void HMM::maximise(const Statistics &statistics)
+{
+	const int M = lambda.b.cols(), N = lambda.b.rows(), D = lambda.means.cols();
+
+	double pi_denominator = 0.0;
+	for (int i = 0; i < N; ++i)
+	{
+		pi_denominator += statistics.pi[i];
+	}
+	for (int i = 0; i < N && pi_denominator != 0.0; ++i)
+	{
+		lambda.pi[i] = statistics.pi[i] / pi_denominator;
+	}
+
 	for (int i = 0; i < N; ++i)
 	{
-		lambda.pi[i] = gamma[0][i];
+		// expected transitions out of a state, so that the row sums to one
+		double a_denominator = 0.0;
+		for (int j = 0; j < N; ++j)
+		{
+			a_denominator += statistics.a_numerator[i][j];
+		}
+		if (a_denominator == 0.0 || statistics.b_denominator[i] == 0.0)
+		{
+			// states that a banded model can not reach keep their values
+			continue;
+		}
+		for (int j = 0; j < N; ++j)
+		{
+			lambda.a[i][j] = statistics.a_numerator[i][j] / a_denominator;
+		}
+		for (int k = 0; k < M; ++k)
+		{
+			// a pseudo count keeps symbols unseen in training from ruling out the state
+			lambda.b[i][k] = (statistics.b_numerator[i][k] + pseudo_count) / (statistics.b_denominator[i] + M * pseudo_count);
+		}
+		for (int k = 0; k < M && lambda.continuous(); ++k)
+		{
+			const int c = i * M + k;
+			const double occupancy = statistics.b_numerator[i][k];
+			for (int d = 0; d < D && occupancy > 0.0; ++d)
+			{
+				const double mean = statistics.x_numerator[c][d] / occupancy;
+				const double variance = statistics.xx_numerator[c][d] / occupancy - mean * mean;
+				lambda.means[c][d] = mean;
+				lambda.variances[c][d] = variance < Model::minimum_variance ? Model::minimum_variance : variance;
+			}
+		}
 	}
 }
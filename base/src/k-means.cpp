@@ -1,74 +1,284 @@
 #include "k-means.h"
 
+#include <algorithm>
+#include <cmath>
+#include <future>
 #include <limits>
+#include <numeric>
+#include <random>
 
 using namespace std;
 
-KMeans::KMeans(const vector<Feature> &universe) :
-	universe(universe)
+KMeans::KMeans(const Features &universe, ThreadPool *thread_pool, bool q_hamerly) :
+	universe(universe), thread_pool(thread_pool), q_hamerly(q_hamerly)
 {
 }
 
-vector<Feature> KMeans::optimise(const vector<Feature> &old_centroids) const
+Features KMeans::optimise(const Features &old_centroids) const
 {
-	vector<Feature> centroids = old_centroids;
+	Features centroids = old_centroids;
 
 	int iteration = 0;
-	pair<double, vector<int>> buckets, new_buckets = classify(centroids);
+	vector<double> lower_bounds;
+	pair<double, vector<int>> buckets, new_buckets = q_hamerly ? classify(centroids, centroids, vector<int>(), lower_bounds) : classify(centroids);
 	do
 	{
 		buckets = new_buckets;
 		iteration += 1;
 
+		const Features old_centroids = centroids;
 		relocate(buckets.second, centroids);
-		new_buckets = classify(centroids);
+		new_buckets = q_hamerly ? classify(old_centroids, centroids, buckets.second, lower_bounds) : classify(centroids);
 	} while (buckets.first - new_buckets.first > convergence_threshold && iteration < convergence_max_iterations);
 
 	return centroids;
 }
 
-pair<double, vector<int>> KMeans::classify(const vector<Feature> &centroids) const
+/// Parts are fixed in size and reduced in order, so the result does not depend on the number of threads.
+pair<double, vector<int>> KMeans::classify(const Features &centroids) const
 {
-	pair<double, vector<int>> buckets(0.0, vector<int>(universe.size(), 0));
+	pair<double, vector<int>> buckets(0.0, vector<int>(universe.rows(), 0));
 
-	for (int i = 0; i < universe.size(); ++i)
+	const Quantiser quantiser(centroids);
+	const int n_parts = (universe.rows() + x_part - 1) / x_part;
+	vector<future<double>> distance_futures;
+	for (int i = 0; i < n_parts && thread_pool != nullptr; ++i)
 	{
-		double min_distance = numeric_limits<double>::max();
-		int min_j = 0;
-		for (int j = 0; j < centroids.size(); ++j)
+		distance_futures.push_back(thread_pool->enqueue(&KMeans::classify_part, this, cref(quantiser), i, ref(buckets.second)));
+	}
+	for (int i = 0; i < n_parts; ++i)
+	{
+		buckets.first += thread_pool != nullptr ? distance_futures[i].get() : classify_part(quantiser, i, buckets.second);
+	}
+
+	return buckets;
+}
+
+/// Making k-means even faster - Greg Hamerly.
+/// The upper bound is kept exact as the distance is needed anyway, so the buckets and distance are same as without bounds.
+pair<double, vector<int>> KMeans::classify(const Features &old_centroids, const Features &centroids, const vector<int> &old_indices, vector<double> &lower_bounds) const
+{
+	pair<double, vector<int>> buckets(0.0, old_indices);
+	const bool q_bounded = !old_indices.empty();
+	if (!q_bounded)
+	{
+		buckets.second = vector<int>(universe.rows(), 0);
+		lower_bounds = vector<double>(universe.rows(), 0.0);
+	}
+
+	const Quantiser quantiser(centroids);
+
+	// a point closer to its centroid than half the distance to the next centroid stays in its bucket
+	vector<int> centroid_rows(centroids.rows()), nearest_indices;
+	for (int i = 0; i < centroids.rows(); ++i)
+	{
+		centroid_rows[i] = i;
+	}
+	vector<double> half_distances, nearest_distances;
+	quantiser.nearest(centroids, centroid_rows, nearest_indices, nearest_distances, half_distances);
+	for (int i = 0; i < centroids.rows(); ++i)
+	{
+		half_distances[i] = sqrt(half_distances[i]) / 2.0;
+	}
+
+	// lower bounds drift by the most any other centroid has moved
+	vector<double> movements(centroids.rows(), 0.0), drifts(centroids.rows(), 0.0);
+	for (int i = 0; i < centroids.rows(); ++i)
+	{
+		movements[i] = sqrt(Feature(old_centroids, i).distance(Feature(centroids, i)));
+	}
+	for (int i = 0; i < centroids.rows(); ++i)
+	{
+		for (int j = 0; j < centroids.rows(); ++j)
 		{
-			const double distance = universe[i].distance(centroids[j]);
-			if (distance < min_distance)
+			if (j != i)
 			{
-				min_distance = distance;
-				min_j = j;
+				drifts[i] = max(drifts[i], movements[j]);
 			}
 		}
-		buckets.first += min_distance;
-		buckets.second[i] = min_j;
+	}
+
+	const int n_parts = (universe.rows() + x_part - 1) / x_part;
+	vector<future<double>> distance_futures;
+	for (int i = 0; i < n_parts && thread_pool != nullptr; ++i)
+	{
+		distance_futures.push_back(thread_pool->enqueue(&KMeans::classify_bounded_part, this, cref(quantiser), cref(half_distances), cref(drifts), q_bounded, i, ref(buckets.second), ref(lower_bounds)));
+	}
+	for (int i = 0; i < n_parts; ++i)
+	{
+		buckets.first += thread_pool != nullptr ? distance_futures[i].get() : classify_bounded_part(quantiser, half_distances, drifts, q_bounded, i, buckets.second, lower_bounds);
 	}
 
 	return buckets;
 }
 
-void KMeans::relocate(const vector<int> &indices, vector<Feature> &centroids) const
+void KMeans::relocate(const vector<int> &indices, Features &centroids) const
 {
-	vector<int> bucket_sizes(centroids.size(), 0);
+	vector<int> bucket_sizes(centroids.rows(), 0);
 
-	centroids = vector<Feature>(centroids.size(), Feature{ vector<double>(centroids[0].coefficients.size(), 0.0) });
-	for (int i = 0; i < universe.size(); ++i)
+	const int n_parts = (universe.rows() + x_part - 1) / x_part;
+	vector<future<pair<Features, vector<int>>>> sum_futures;
+	for (int i = 0; i < n_parts && thread_pool != nullptr; ++i)
+	{
+		sum_futures.push_back(thread_pool->enqueue(&KMeans::relocate_part, this, cref(indices), centroids.rows(), i));
+	}
+	centroids = Features(centroids.rows(), centroids.cols(), 0.0);
+	for (int i = 0; i < n_parts; ++i)
 	{
-		for (int j = 0; j < universe[0].coefficients.size(); ++j)
+		const pair<Features, vector<int>> sums = thread_pool != nullptr ? sum_futures[i].get() : relocate_part(indices, centroids.rows(), i);
+		for (int j = 0; j < centroids.rows(); ++j)
 		{
-			centroids[indices[i]].coefficients[j] += universe[i].coefficients[j];
+			for (int k = 0; k < centroids.cols(); ++k)
+			{
+				centroids[j][k] += sums.first[j][k];
+			}
+			bucket_sizes[j] += sums.second[j];
 		}
-		bucket_sizes[indices[i]]++;
 	}
-	for (int i = 0; i < centroids.size(); ++i)
+	for (int i = 0; i < centroids.rows(); ++i)
 	{
-		for (int j = 0; j < centroids[0].coefficients.size(); ++j)
+		for (int j = 0; j < centroids.cols(); ++j)
 		{
-			centroids[i].coefficients[j] /= bucket_sizes[i];
+			centroids[i][j] /= bucket_sizes[i];
 		}
 	}
 }
+
+double KMeans::classify_part(const Quantiser &quantiser, int part, vector<int> &indices) const
+{
+	const int begin = part * x_part, end = min(begin + x_part, universe.rows());
+
+	return quantiser.classify(universe, begin, end, indices);
+}
+
+double KMeans::classify_bounded_part(const Quantiser &quantiser, const vector<double> &half_distances, const vector<double> &drifts, bool q_bounded, int part, vector<int> &indices, vector<double> &lower_bounds) const
+{
+	const int begin = part * x_part, end = min(begin + x_part, universe.rows());
+
+	vector<int> rows;
+	vector<double> distances(end - begin, 0.0);
+	for (int i = begin; i < end; ++i)
+	{
+		if (!q_bounded)
+		{
+			rows.push_back(i);
+			continue;
+		}
+
+		const int j = indices[i];
+		lower_bounds[i] -= drifts[j];
+		distances[i - begin] = quantiser.distance(universe[i], j);
+		if (sqrt(distances[i - begin]) >= max(half_distances[j], lower_bounds[i]))
+		{
+			rows.push_back(i);
+		}
+	}
+
+	// points which may have changed buckets are compared with all centroids
+	vector<int> row_indices;
+	vector<double> row_distances, row_second_distances;
+	quantiser.nearest(universe, rows, row_indices, row_distances, row_second_distances);
+	for (int r = 0; r < rows.size(); ++r)
+	{
+		indices[rows[r]] = row_indices[r];
+		distances[rows[r] - begin] = row_distances[r];
+		lower_bounds[rows[r]] = sqrt(row_second_distances[r]);
+	}
+
+	double total_distance = 0.0;
+	for (int i = 0; i < distances.size(); ++i)
+	{
+		total_distance += distances[i];
+	}
+
+	return total_distance;
+}
+
+pair<Features, vector<int>> KMeans::relocate_part(const vector<int> &indices, int n_centroids, int part) const
+{
+	pair<Features, vector<int>> sums(Features(n_centroids, universe.cols(), 0.0), vector<int>(n_centroids, 0));
+
+	const int begin = part * x_part, end = min(begin + x_part, universe.rows());
+	for (int i = begin; i < end; ++i)
+	{
+		for (int j = 0; j < universe.cols(); ++j)
+		{
+			sums.first[indices[i]][j] += universe[i][j];
+		}
+		sums.second[indices[i]]++;
+	}
+
+	return sums;
+}
+
+MiniBatchKMeans::MiniBatchKMeans(const function<Features(int)> &source, int n_chunks, int x_batch, double p_sample) :
+	source(source), n_chunks(n_chunks), x_batch(x_batch), p_sample(p_sample)
+{
+}
+
+/// Chunks are visited in a shuffled order every epoch, the generator is seeded so that the result can be repeated.
+Features MiniBatchKMeans::optimise(const Features &old_centroids) const
+{
+	Features centroids = old_centroids;
+
+	mt19937 generator(seed);
+	bernoulli_distribution sampler(p_sample);
+	vector<int> bucket_sizes(centroids.rows(), 0), order(n_chunks);
+	iota(order.begin(), order.end(), 0);
+
+	double distance = numeric_limits<double>::max(), new_distance;
+	for (int epoch = 0; epoch < convergence_max_epochs; ++epoch)
+	{
+		shuffle(order.begin(), order.end(), generator);
+
+		Features batch;
+		double total_distance = 0.0;
+		long long n_sampled = 0;
+		for (int i = 0; i < n_chunks; ++i)
+		{
+			const Features chunk = source(order[i]);
+			for (int j = 0; j < chunk.rows(); ++j)
+			{
+				if (sampler(generator))
+				{
+					batch.push_back(vector<double>(chunk[j], chunk[j] + chunk.cols()));
+				}
+			}
+			if (batch.rows() >= x_batch || (i == n_chunks - 1 && !batch.empty()))
+			{
+				total_distance += update(batch, bucket_sizes, centroids);
+				n_sampled += batch.rows();
+				batch = Features();
+			}
+		}
+
+		// batches are measured before they move the centroids, so the mean distance is an unbiased estimate
+		new_distance = n_sampled > 0 ? total_distance / n_sampled : 0.0;
+		if (distance - new_distance <= convergence_threshold * new_distance)
+		{
+			break;
+		}
+		distance = new_distance;
+	}
+
+	return centroids;
+}
+
+/// Each centroid moves with a learning rate of inverse of the number of vectors it has seen.
+double MiniBatchKMeans::update(const Features &batch, vector<int> &bucket_sizes, Features &centroids)
+{
+	const pair<double, vector<int>> buckets = Quantiser(centroids).classify(batch);
+
+	for (int i = 0; i < batch.rows(); ++i)
+	{
+		const int c = buckets.second[i];
+		bucket_sizes[c]++;
+		const double eta = 1.0 / bucket_sizes[c];
+		for (int j = 0; j < centroids.cols(); ++j)
+		{
+			centroids[c][j] = (1.0 - eta) * centroids[c][j] + eta * batch[i][j];
+		}
+	}
+
+	return buckets.first;
+}
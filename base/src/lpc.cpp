@@ -22,17 +22,17 @@ vector<double> LPC::setup_sine_coefficients(int n_cepstra)
 	return sine_coefficients;
 }
 
-Feature LPC::feature(const vector<double> &frame) const
+vector<double> LPC::feature(const vector<double> &frame) const
 {
-	Feature feature;
+	vector<double> C;
 
 	const vector<double> R = auto_correlation(frame);
 	const vector<double> A = durbin_solve(R);
 	const double G_squared = gain(R, A);
-	feature.coefficients = cepstral_coefficients(G_squared, A);
-	sine_window(feature.coefficients);
+	C = cepstral_coefficients(G_squared, A);
+	sine_window(C);
 
-	return feature;
+	return C;
 }
 
 vector<double> LPC::auto_correlation(const vector<double> &frame) const
@@ -2,19 +2,21 @@
 
 #include <algorithm>
 #include <cmath>
+#include <complex>
 #include <functional>
 #include <numeric>
 
 using namespace std;
 
-MFC::MFC(int n_cepstra, bool q_gain, bool q_delta, bool q_accel) :
-	ICepstral(n_cepstra, q_gain, q_delta, q_accel), filter_bank(setup_filter_bank()), dct_matrix(setup_dct_matrix(n_cepstra))
+MFC::MFC(int n_cepstra, bool q_gain, bool q_delta, bool q_accel, int n_filters, int n_fft, double hz_low, double hz_high, double hz_sampling) :
+	ICepstral(n_cepstra, q_gain, q_delta, q_accel), n_filters(n_filters), n_fft(FFT::round_size(n_fft)), n_fft_bins(FFT::round_size(n_fft) / 2 + 1), fft(n_fft),
+	filter_bank(setup_filter_bank(n_filters, FFT::round_size(n_fft) / 2 + 1, hz_low, hz_high, hz_sampling)), dct_matrix(setup_dct_matrix(n_cepstra, n_filters))
 {
 }
 
-vector<vector<double>> MFC::setup_filter_bank()
+vector<MFC::Filter> MFC::setup_filter_bank(int n_filters, int n_fft_bins, double hz_low, double hz_high, double hz_sampling)
 {
-	vector<vector<double>> filter_bank(n_filters, vector<double>(n_fft_bins, 0.0));
+	vector<Filter> filter_bank(n_filters, Filter{ 0, vector<double>() });
 
 	// filter centre-frequencies
 	vector<double> hz_filter_center(n_filters + 2, 0.0);
@@ -33,29 +35,30 @@ vector<vector<double>> MFC::setup_filter_bank()
 		hz_fft_bin[i] = hz_sampling / 2.0 / (n_fft_bins - 1.0) * i;
 	}
 
+	// keep only the bins that lie inside the triangle
 	for (int filter = 1; filter <= n_filters; ++filter)
 	{
-		for (int bin = 0; bin < n_fft_bins; ++bin)
+		int bin = 0;
+		while (bin < n_fft_bins && hz_fft_bin[bin] < hz_filter_center[filter - 1])
 		{
-			if (hz_fft_bin[bin] < hz_filter_center[filter - 1])
-			{
-				filter_bank[filter - 1][bin] = 0.0;
-			}
-			else if (hz_fft_bin[bin] <= hz_filter_center[filter])
-			{
-				filter_bank[filter - 1][bin] = (hz_fft_bin[bin] - hz_filter_center[filter - 1]) / (hz_filter_center[filter] - hz_filter_center[filter - 1]);
-			}
-			else if (hz_fft_bin[bin] <= hz_filter_center[filter + 1])
-			{
-				filter_bank[filter - 1][bin] = (hz_filter_center[filter + 1] - hz_fft_bin[bin]) / (hz_filter_center[filter + 1] - hz_filter_center[filter]);
-			}
+			++bin;
+		}
+		filter_bank[filter - 1].bin = bin;
+
+		for (; bin < n_fft_bins && hz_fft_bin[bin] <= hz_filter_center[filter]; ++bin)
+		{
+			filter_bank[filter - 1].weights.push_back((hz_fft_bin[bin] - hz_filter_center[filter - 1]) / (hz_filter_center[filter] - hz_filter_center[filter - 1]));
+		}
+		for (; bin < n_fft_bins && hz_fft_bin[bin] <= hz_filter_center[filter + 1]; ++bin)
+		{
+			filter_bank[filter - 1].weights.push_back((hz_filter_center[filter + 1] - hz_fft_bin[bin]) / (hz_filter_center[filter + 1] - hz_filter_center[filter]));
 		}
 	}
 
 	return filter_bank;
 }
 
-vector<vector<double>> MFC::setup_dct_matrix(int n_cepstra)
+vector<vector<double>> MFC::setup_dct_matrix(int n_cepstra, int n_filters)
 {
 	vector<vector<double>> dct_matrix(n_cepstra + 1, vector<double>(n_filters, 0.0));
 
@@ -71,111 +74,61 @@ vector<vector<double>> MFC::setup_dct_matrix(int n_cepstra)
 	return dct_matrix;
 }
 
-Feature MFC::feature(const vector<double> &frame) const
+/// The spectrum and filterbank buffers of the thread are reused, only the returned feature is allocated per frame.
+vector<double> MFC::feature(const vector<double> &frame) const
 {
-	Feature feature;
+	vector<double> C(n_cepstra + 1, 0.0);
 
-	const vector<double> P = power_spectrum(frame);
-	const vector<double> H = lmfb(P);
-	feature.coefficients = dct(H);
-	normalise(feature.coefficients);
+	thread_local vector<double> P, H;
+	power_spectrum(frame, P);
+	lmfb(P, H);
+	dct(H, C);
+	normalise(C);
 
-	return feature;
+	return C;
 }
 
-vector<double> MFC::power_spectrum(const vector<double> &frame) const
+void MFC::power_spectrum(const vector<double> &frame, vector<double> &P) const
 {
-	vector<double> P(n_fft_bins, 0.0);
+	P.resize(n_fft_bins);
 
-	vector<complex<double>> complex_frame(frame.begin(), frame.end());
-	complex_frame.resize(n_fft, complex<double>());
-	fft(complex_frame);
+	// reuse the spectrum of the thread so that frames do not allocate
+	thread_local vector<complex<double>> X;
+	fft.transform(frame, X);
 	for (int i = 0; i < n_fft_bins; ++i)
 	{
-		P[i] = pow(abs(complex_frame[i]), 2);
+		P[i] = norm(X[i]);
 	}
-
-	return P;
 }
 
-/// https://rosettacode.org/wiki/Fast_Fourier_transform
-/// http://en.dsplib.org/content/fft_dec_in_freq/fft_dec_in_freq.html
-void MFC::fft(vector<complex<double>> &x) const
+void MFC::lmfb(const vector<double> &P, vector<double> &H) const
 {
-	const int N = x.size();
-
-	// DFT
-	int n = N;
-	const double theta = 4.0 * atan(1.0) / N;
-	complex<double> phi(cos(theta), -sin(theta));
-	while (n > 1)
-	{
-		n >>= 1;
-		phi *= phi;
-
-		complex<double> R(1.0, 0.0);
-		for (int i = 0; i < n; ++i)
-		{
-			for (int j = i; j < N; j += n * 2)
-			{
-				const complex<double> t = x[j] - x[j + n];
-				x[j] += x[j + n];
-				x[j + n] = t * R;
-			}
-			R *= phi;
-		}
-	}
-
-	// decimation
-	const int m = log2(N);
-	for (int i = 0; i < N; ++i)
-	{
-		// reverse bits
-		int j = i;
-		j = ((j & 0xaaaaaaaa) >> 1) | ((j & 0x55555555) << 1);
-		j = ((j & 0xcccccccc) >> 2) | ((j & 0x33333333) << 2);
-		j = ((j & 0xf0f0f0f0) >> 4) | ((j & 0x0f0f0f0f) << 4);
-		j = ((j & 0xff00ff00) >> 8) | ((j & 0x00ff00ff) << 8);
-		j = ((j >> 16) | (j << 16)) >> (32 - m);
-
-		if (j > i)
-		{
-			swap(x[i], x[j]);
-		}
-	}
-}
-
-vector<double> MFC::lmfb(const vector<double> &P) const
-{
-	vector<double> H(n_filters, 0.0);
+	H.assign(n_filters, 0.0);
 
 	for (int i = 0; i < n_filters; ++i)
 	{
-		for (int j = 0; j < n_fft_bins; ++j)
+		const Filter &filter = filter_bank[i];
+		const double *P_filter = P.data() + filter.bin;
+		for (int j = 0; j < filter.weights.size(); ++j)
 		{
-			H[i] += filter_bank[i][j] * P[j];
+			H[i] += filter.weights[j] * P_filter[j];
 		}
 
 		H[i] = max(H[i], 1.0);
 		H[i] = log(H[i]);
 	}
-
-	return H;
 }
 
-vector<double> MFC::dct(const vector<double> &H) const
+void MFC::dct(const vector<double> &H, vector<double> &C) const
 {
-	vector<double> C(n_cepstra + 1, 0.0);
-
 	for (int i = 0; i < n_cepstra + 1; ++i)
 	{
+		C[i] = 0.0;
 		for (int j = 0; j < n_filters; ++j)
 		{
 			C[i] += dct_matrix[i][j] * H[j];
 		}
 	}
-
-	return C;
 }
 
 void MFC::normalise(vector<double> &C) const
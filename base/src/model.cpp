@@ -1,5 +1,6 @@
 ﻿#include "model.h"
 
+#include <cmath>
 #include <sstream>
 
 #include "io.h"
@@ -13,7 +14,7 @@ Model::Builder::Builder(int N, int M, int step) :
 
 Model Model::Builder::bakis() const
 {
-	Model model{ vector<vector<double>>(N, vector<double>(N, 0.0)), vector<vector<double>>(N, vector<double>(M, 1.0 / M)), vector<double>(N, 0.0) };
+	Model model{ Matrix<double>(N, N, 0.0), Matrix<double>(N, M, 1.0 / M), vector<double>(N, 0.0), Matrix<double>(), Matrix<double>() };
 
 	for (int i = 0; i < N - step; ++i)
 	{
@@ -36,51 +37,45 @@ Model Model::Builder::bakis() const
 	return model;
 }
 
-Model Model::Builder::merge(const vector<Model> &models) const
+/// Mixtures of a state are spread around its mean along the deviation.
+Model Model::Builder::bakis(const vector<Features> &xs) const
 {
-	Model model{ vector<vector<double>>(N, vector<double>(N, 0.0)), vector<vector<double>>(N, vector<double>(M, 0.0)), vector<double>(N, 0.0) };
+	Model model = bakis();
 
-	int Q = models.size();
-	for (int i = 0; i < Q; ++i)
+	const int D = xs.empty() ? 0 : xs[0].cols();
+	vector<double> counts(N, 0.0);
+	Matrix<double> sums(N, D, 0.0), squares(N, D, 0.0);
+	for (int q = 0; q < xs.size(); ++q)
 	{
-		for (int j = 0; j < N; ++j)
+		const int T = xs[q].rows();
+		for (int t = 0; t < T; ++t)
 		{
-			for (int k = 0; k < N; ++k)
+			const int i = t * N / T;
+			for (int d = 0; d < D; ++d)
 			{
-				model.a[j][k] += models[i].a[j][k];
+				sums[i][d] += xs[q][t][d];
+				squares[i][d] += xs[q][t][d] * xs[q][t][d];
 			}
-		}
-		for (int j = 0; j < N; ++j)
-		{
-			for (int k = 0; k < M; ++k)
-			{
-				model.b[j][k] += models[i].b[j][k];
-			}
-		}
-		for (int j = 0; j < N; ++j)
-		{
-			model.pi[j] += models[i].pi[j];
+			counts[i]++;
 		}
 	}
 
-	for (int j = 0; j < N; ++j)
-	{
-		for (int k = 0; k < N; ++k)
-		{
-			model.a[j][k] /= Q;
-		}
-	}
-	for (int j = 0; j < N; ++j)
+	model.means = Matrix<double>(N * M, D, 0.0);
+	model.variances = Matrix<double>(N * M, D, 1.0);
+	for (int i = 0; i < N; ++i)
 	{
-		for (int k = 0; k < M; ++k)
+		for (int d = 0; d < D && counts[i] > 0; ++d)
 		{
-			model.b[j][k] /= Q;
+			const double mean = sums[i][d] / counts[i];
+			double variance = squares[i][d] / counts[i] - mean * mean;
+			variance = variance < minimum_variance ? minimum_variance : variance;
+			for (int k = 0; k < M; ++k)
+			{
+				model.means[i * M + k][d] = mean + (k - (M - 1) / 2.0) * epsilon * sqrt(variance);
+				model.variances[i * M + k][d] = variance;
+			}
 		}
 	}
-	for (int i = 0; i < N; ++i)
-	{
-		model.pi[i] /= Q;
-	}
 
 	return model;
 }
@@ -90,6 +85,11 @@ bool Model::empty() const
 	return a.empty() || b.empty() || pi.empty();
 }
 
+bool Model::continuous() const
+{
+	return !means.empty();
+}
+
 istream &operator>>(istream &input, Model &model)
 {
 	string line;
@@ -108,15 +108,29 @@ istream &operator>>(istream &input, Model &model)
 	{
 		stream << line << '\n';
 	}
-	model.a = IO::get_matrix_from_stream<double>(stream);
+	stream >> model.a;
 
 	// b
 	stream = std::stringstream();
+	while (std::getline(input, line) && line != "means")
+	{
+		stream << line << '\n';
+	}
+	stream >> model.b;
+
+	// means and variances of continuous models
+	stream = std::stringstream();
+	while (std::getline(input, line) && line != "variances")
+	{
+		stream << line << '\n';
+	}
+	stream >> model.means;
+	stream = std::stringstream();
 	while (std::getline(input, line))
 	{
 		stream << line << '\n';
 	}
-	model.b = IO::get_matrix_from_stream<double>(stream);
+	stream >> model.variances;
 
 	return input;
 }
@@ -126,9 +140,26 @@ ostream &operator<<(ostream &output, const Model &model)
 	output << "pi" << '\n';
 	output << IO::get_string_from_vector<double>(model.pi) << '\n';
 	output << "a" << '\n';
-	output << IO::get_string_from_matrix<double>(model.a) << '\n';
+	output << model.a << '\n';
 	output << "b" << '\n';
-	output << IO::get_string_from_matrix<double>(model.b) << '\n';
+	output << model.b << '\n';
+	if (model.continuous())
+	{
+		output << "means" << '\n';
+		output << model.means << '\n';
+		output << "variances" << '\n';
+		output << model.variances << '\n';
+	}
 
 	return output;
 }
+
+BinaryReader &operator>>(BinaryReader &input, Model &model)
+{
+	return input >> model.pi >> model.a >> model.b >> model.means >> model.variances;
+}
+
+BinaryWriter &operator<<(BinaryWriter &output, const Model &model)
+{
+	return output << model.pi << model.a << model.b << model.means << model.variances;
+}
@@ -38,9 +38,84 @@ ostream &operator<<(ostream &output, const Gram &gram)
 	return output;
 }
 
+/// Words of the keys are kept once, each row has the indices of the words of a key followed by its count.
+BinaryReader &operator>>(BinaryReader &input, Gram &gram)
+{
+	string words;
+	Matrix<int> table;
+	input >> words >> table;
+
+	stringstream stream(words);
+	const vector<string> vocabulary = IO::get_vector_from_stream<string>(stream, '\n');
+	gram.counts.clear();
+	for (int i = 0; i < table.rows(); ++i)
+	{
+		vector<string> key;
+		for (int j = 0; j < table.cols() - 1; ++j)
+		{
+			key.push_back(vocabulary[table[i][j]]);
+		}
+		gram.counts[key] = table[i][table.cols() - 1];
+	}
+
+	return input;
+}
+
+BinaryWriter &operator<<(BinaryWriter &output, const Gram &gram)
+{
+	map<string, int> indices;
+	vector<string> vocabulary;
+	const int n = gram.counts.empty() ? 0 : gram.counts.begin()->first.size();
+	Matrix<int> table(gram.counts.size(), n + 1, 0);
+
+	int i = 0;
+	for (map<vector<string>, int>::const_iterator it = gram.counts.begin(); it != gram.counts.end(); ++it, ++i)
+	{
+		for (int j = 0; j < n; ++j)
+		{
+			const string &word = it->first[j];
+			if (indices.find(word) == indices.end())
+			{
+				indices[word] = vocabulary.size();
+				vocabulary.push_back(word);
+			}
+			table[i][j] = indices[word];
+		}
+		table[i][n] = it->second;
+	}
+
+	return output << IO::get_string_from_vector<string>(vocabulary, '\n') << table;
+}
+
 MLE::MLE(vector<Gram> grams) :
-	grams(grams)
+	MLE(grams, vector<string>())
+{
+}
+
+MLE::MLE(vector<Gram> grams, const vector<string> &words) :
+	grams(grams), indexed_counts(grams.size())
 {
+	map<string, int> indices;
+	for (int i = 0; i < words.size(); ++i)
+	{
+		indices[words[i]] = i;
+	}
+
+	for (int n = 0; n < grams.size() && !words.empty(); ++n)
+	{
+		for (map<vector<string>, int>::const_iterator it = grams[n].counts.begin(); it != grams[n].counts.end(); ++it)
+		{
+			vector<int> key;
+			for (int j = 0; j < it->first.size() && indices.find(it->first[j]) != indices.end(); ++j)
+			{
+				key.push_back(indices[it->first[j]]);
+			}
+			if (key.size() == it->first.size())
+			{
+				indexed_counts[n][key] = it->second;
+			}
+		}
+	}
 }
 
 double MLE::score(const vector<string> &context, const string &word) const
@@ -55,3 +130,17 @@ double MLE::score(const vector<string> &context, const string &word) const
 
 	return P;
 }
+
+double MLE::score(const vector<int> &context, int word) const
+{
+	double P = 0.0;
+
+	vector<int> sentence = context; sentence.push_back(word);
+	const map<vector<int>, int>::const_iterator it = indexed_counts[sentence.size()].find(sentence);
+	if (it != indexed_counts[sentence.size()].end())
+	{
+		P = (double)it->second / indexed_counts[context.size()].at(context);
+	}
+
+	return P;
+}
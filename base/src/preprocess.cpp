@@ -29,6 +29,113 @@ vector<vector<double>> Preprocessor::process(const vector<double> &unprocessed_s
 	return frames;
 }
 
+Preprocessor::Stream::Stream(const Preprocessor &preprocessor) :
+	preprocessor(preprocessor), n_samples(0), sum_samples(0.0), max_sample(0.0),
+	q_bg(false), mean_bg(0.0), sd_bg(0.0), emphasized_sample(0.0), trim_samples(), frame_samples()
+{
+}
+
+vector<vector<double>> Preprocessor::Stream::push(const vector<double> &samples)
+{
+	for (int i = 0; i < samples.size(); ++i)
+	{
+		// running dc offset and peak
+		n_samples += 1;
+		sum_samples += samples[i];
+		const double sample = samples[i] - sum_samples / n_samples;
+		max_sample = max(max_sample, abs(sample));
+		trim_samples.push_back(sample);
+	}
+
+	if (preprocessor.q_trim && !q_bg)
+	{
+		if (trim_samples.size() < x_bg_window)
+		{
+			// wait for the background
+			return vector<vector<double>>();
+		}
+		background();
+	}
+
+	return framing(trim());
+}
+
+vector<vector<double>> Preprocessor::Stream::flush()
+{
+	if (preprocessor.q_trim && !q_bg && !trim_samples.empty())
+	{
+		// utterance is shorter than the background window
+		background();
+	}
+
+	return framing(trim());
+}
+
+void Preprocessor::Stream::background()
+{
+	const int x_window = min((int)trim_samples.size(), x_bg_window);
+	const vector<double> bg(trim_samples.begin(), trim_samples.begin() + x_window);
+	mean_bg = accumulate(bg.begin(), bg.end(), 0.0) / x_window;
+	sd_bg = sqrt(accumulate(bg.begin(), bg.end(), 0.0, [this](double a, double b) { return a + pow(b - mean_bg, 2); }) / x_window);
+	q_bg = true;
+}
+
+/// Windows are voiced as in the batch trim but decided as soon as they are complete, the results still differ from the batch.
+/// The background mean is divided by the background window where the batch divides it by all samples,
+/// and the dc offset is a running mean which zeroes the first sample and lags the mean of all samples.
+vector<double> Preprocessor::Stream::trim()
+{
+	vector<double> trimmed_samples;
+
+	if (!preprocessor.q_trim)
+	{
+		trimmed_samples.swap(trim_samples);
+		return trimmed_samples;
+	}
+
+	int i = 0;
+	for (; i <= (int)trim_samples.size() - x_trim_window; i += x_trim_window)
+	{
+		int voiced = 0;
+		for (int j = 0; j < x_trim_window; ++j)
+		{
+			double distance = abs(trim_samples[i + j] - mean_bg) / sd_bg;
+			voiced += distance > 3.0 ? 1 : -1;
+		}
+		if (voiced > 0)
+		{
+			trimmed_samples.insert(trimmed_samples.end(), trim_samples.begin() + i, trim_samples.begin() + i + x_trim_window);
+		}
+	}
+	trim_samples.erase(trim_samples.begin(), trim_samples.begin() + i);
+
+	return trimmed_samples;
+}
+
+vector<vector<double>> Preprocessor::Stream::framing(const vector<double> &samples)
+{
+	vector<vector<double>> frames;
+
+	// running normalisation with the peak seen so far
+	const double normalisation_factor = max_sample > 0.0 ? normalisation_value / max_sample : 1.0;
+	for (int i = 0; i < samples.size(); ++i)
+	{
+		emphasized_sample = samples[i] * normalisation_factor - pre_emphasis_factor * emphasized_sample;
+		frame_samples.push_back(emphasized_sample);
+	}
+
+	int i = 0;
+	for (; i <= (int)frame_samples.size() - preprocessor.x_frame; i += preprocessor.x_overlap)
+	{
+		vector<double> frame(frame_samples.begin() + i, frame_samples.begin() + i + preprocessor.x_frame);
+		preprocessor.hamming_window(frame);
+		frames.push_back(frame);
+	}
+	frame_samples.erase(frame_samples.begin(), frame_samples.begin() + min(i, (int)frame_samples.size()));
+
+	return frames;
+}
+
 vector<double> Preprocessor::setup_hamming_coefficients(int x_frame)
 {
 	vector<double> hamming_coefficients(x_frame, 0.54);
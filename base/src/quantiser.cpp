@@ -0,0 +1,234 @@
+#include "quantiser.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "cpu.h"
+
+using namespace std;
+
+Quantiser::Quantiser(const Features &centroids) :
+	n_centroids(centroids.rows()), n_padded((centroids.rows() + x_lanes - 1) / x_lanes * x_lanes),
+	table(setup_table(centroids, (centroids.rows() + x_lanes - 1) / x_lanes * x_lanes)), kernel(setup_kernel())
+{
+}
+
+pair<double, vector<int>> Quantiser::classify(const Features &features) const
+{
+	pair<double, vector<int>> buckets(0.0, vector<int>(features.rows(), 0));
+
+	buckets.first = classify(features, 0, features.rows(), buckets.second);
+
+	return buckets;
+}
+
+double Quantiser::classify(const Features &features, int begin, int end, vector<int> &indices) const
+{
+	double total_distance = 0.0;
+
+	vector<double> distances(x_block * n_padded, 0.0);
+	for (int i = begin; i < end; i += x_block)
+	{
+		// the last block repeats its last feature
+		const int n_x = min(x_block, end - i);
+		const double *x[x_block];
+		for (int f = 0; f < x_block; ++f)
+		{
+			x[f] = features[i + min(f, n_x - 1)];
+		}
+		kernel(x, table[0], table.rows(), table.stride(), n_padded, distances.data());
+
+		for (int f = 0; f < n_x; ++f)
+		{
+			const double *feature_distances = distances.data() + f * n_padded;
+			double min_distance = numeric_limits<double>::max();
+			int min_j = 0;
+			for (int j = 0; j < n_centroids; ++j)
+			{
+				if (feature_distances[j] < min_distance)
+				{
+					min_distance = feature_distances[j];
+					min_j = j;
+				}
+			}
+			total_distance += min_distance;
+			indices[i + f] = min_j;
+		}
+	}
+
+	return total_distance;
+}
+
+void Quantiser::nearest(const Features &features, const vector<int> &rows, vector<int> &indices, vector<double> &distances, vector<double> &second_distances) const
+{
+	indices.resize(rows.size());
+	distances.resize(rows.size());
+	second_distances.resize(rows.size());
+
+	vector<double> block_distances(x_block * n_padded, 0.0);
+	for (int i = 0; i < rows.size(); i += x_block)
+	{
+		// the last block repeats its last feature
+		const int n_x = min(x_block, (int)rows.size() - i);
+		const double *x[x_block];
+		for (int f = 0; f < x_block; ++f)
+		{
+			x[f] = features[rows[i + min(f, n_x - 1)]];
+		}
+		kernel(x, table[0], table.rows(), table.stride(), n_padded, block_distances.data());
+
+		for (int f = 0; f < n_x; ++f)
+		{
+			const double *feature_distances = block_distances.data() + f * n_padded;
+			double min_distance = numeric_limits<double>::max(), second_distance = numeric_limits<double>::max();
+			int min_j = 0;
+			for (int j = 0; j < n_centroids; ++j)
+			{
+				if (feature_distances[j] < min_distance)
+				{
+					second_distance = min_distance;
+					min_distance = feature_distances[j];
+					min_j = j;
+				}
+				else if (feature_distances[j] < second_distance)
+				{
+					second_distance = feature_distances[j];
+				}
+			}
+			indices[i + f] = min_j;
+			distances[i + f] = min_distance;
+			second_distances[i + f] = second_distance;
+		}
+	}
+}
+
+/// Dimensions are accumulated in the same order as the kernels, which all round the same.
+double Quantiser::distance(const double *x, int j) const
+{
+	double distance = 0.0;
+
+	for (int d = 0; d < table.rows(); ++d)
+	{
+		const double difference = x[d] - table[d][j];
+		distance += difference * difference;
+	}
+
+	return distance;
+}
+
+Matrix<double> Quantiser::setup_table(const Features &centroids, int n_padded)
+{
+	// padded centroids are zero and never looked at
+	Matrix<double> table(centroids.cols(), n_padded, 0.0);
+
+	for (int i = 0; i < centroids.rows(); ++i)
+	{
+		for (int j = 0; j < centroids.cols(); ++j)
+		{
+			table[j][i] = centroids[i][j];
+		}
+	}
+
+	return table;
+}
+
+Quantiser::Kernel Quantiser::setup_kernel()
+{
+	if (CPU::avx2())
+	{
+		return &Quantiser::avx2_kernel;
+	}
+	if (CPU::sse2())
+	{
+		return &Quantiser::sse2_kernel;
+	}
+
+	return &Quantiser::scalar_kernel;
+}
+
+void Quantiser::scalar_kernel(const double *const *x, const double *table, int n_dims, int x_stride, int n_padded, double *distances)
+{
+	for (int f = 0; f < x_block; ++f)
+	{
+		double *feature_distances = distances + f * n_padded;
+		for (int j = 0; j < n_padded; ++j)
+		{
+			feature_distances[j] = 0.0;
+		}
+		for (int d = 0; d < n_dims; ++d)
+		{
+			const double x_d = x[f][d];
+			const double *c = table + d * x_stride;
+			for (int j = 0; j < n_padded; ++j)
+			{
+				const double difference = x_d - c[j];
+				feature_distances[j] += difference * difference;
+			}
+		}
+	}
+}
+
+#ifdef SR_LIB_X86
+SR_LIB_TARGET("sse2")
+void Quantiser::sse2_kernel(const double *const *x, const double *table, int n_dims, int x_stride, int n_padded, double *distances)
+{
+	for (int j = 0; j < n_padded; j += 2)
+	{
+		__m128d acc[x_block];
+		for (int f = 0; f < x_block; ++f)
+		{
+			acc[f] = _mm_setzero_pd();
+		}
+		for (int d = 0; d < n_dims; ++d)
+		{
+			const __m128d c = _mm_loadu_pd(table + d * x_stride + j);
+			for (int f = 0; f < x_block; ++f)
+			{
+				const __m128d difference = _mm_sub_pd(_mm_set1_pd(x[f][d]), c);
+				acc[f] = _mm_add_pd(acc[f], _mm_mul_pd(difference, difference));
+			}
+		}
+		for (int f = 0; f < x_block; ++f)
+		{
+			_mm_storeu_pd(distances + f * n_padded + j, acc[f]);
+		}
+	}
+}
+
+/// Products are added without fusing, so that the distances are the same whichever kernel is chosen.
+SR_LIB_TARGET("avx2")
+void Quantiser::avx2_kernel(const double *const *x, const double *table, int n_dims, int x_stride, int n_padded, double *distances)
+{
+	for (int j = 0; j < n_padded; j += 4)
+	{
+		__m256d acc[x_block];
+		for (int f = 0; f < x_block; ++f)
+		{
+			acc[f] = _mm256_setzero_pd();
+		}
+		for (int d = 0; d < n_dims; ++d)
+		{
+			const __m256d c = _mm256_loadu_pd(table + d * x_stride + j);
+			for (int f = 0; f < x_block; ++f)
+			{
+				const __m256d difference = _mm256_sub_pd(_mm256_set1_pd(x[f][d]), c);
+				acc[f] = _mm256_add_pd(acc[f], _mm256_mul_pd(difference, difference));
+			}
+		}
+		for (int f = 0; f < x_block; ++f)
+		{
+			_mm256_storeu_pd(distances + f * n_padded + j, acc[f]);
+		}
+	}
+}
+#else
+void Quantiser::sse2_kernel(const double *const *x, const double *table, int n_dims, int x_stride, int n_padded, double *distances)
+{
+	scalar_kernel(x, table, n_dims, x_stride, n_padded, distances);
+}
+
+void Quantiser::avx2_kernel(const double *const *x, const double *table, int n_dims, int x_stride, int n_padded, double *distances)
+{
+	scalar_kernel(x, table, n_dims, x_stride, n_padded, distances);
+}
+#endif
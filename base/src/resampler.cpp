@@ -0,0 +1,111 @@
+#include "resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+using namespace std;
+
+Resampler::Resampler(int hz_input, int hz_output) :
+	n_up(hz_input > 0 && hz_output > 0 ? hz_output / gcd(hz_input, hz_output) : 1), n_down(hz_input > 0 && hz_output > 0 ? hz_input / gcd(hz_input, hz_output) : 1),
+	x_half(setup_half(n_up, n_down)), phases(setup_phases(n_up, n_down, x_half)),
+	n_input(0), n_output(0), first(-x_half), history(x_half, 0.0)
+{
+}
+
+vector<double> Resampler::push(const vector<double> &samples)
+{
+	if (n_up == n_down)
+	{
+		return samples;
+	}
+
+	history.insert(history.end(), samples.begin(), samples.end());
+	n_input += samples.size();
+
+	return resample(numeric_limits<int64_t>::max());
+}
+
+/// The history is padded with silence so that the taps of the last output samples are complete.
+vector<double> Resampler::flush()
+{
+	if (n_up == n_down)
+	{
+		return vector<double>();
+	}
+
+	history.insert(history.end(), x_half, 0.0);
+
+	return resample((n_input * n_up + n_down - 1) / n_down);
+}
+
+/// The filter is widened when downsampling so that its cutoff stays below both nyquist rates.
+int Resampler::setup_half(int n_up, int n_down)
+{
+	if (n_up == n_down)
+	{
+		return 0;
+	}
+
+	return static_cast<int>(ceil(n_zeros * max(1.0, static_cast<double>(n_down) / n_up)));
+}
+
+Matrix<double> Resampler::setup_phases(int n_up, int n_down, int x_half)
+{
+	Matrix<double> phases(n_up, 2 * x_half, 0.0);
+
+	const double pi = 4.0 * atan(1.0);
+	const double scale = min(1.0, static_cast<double>(n_up) / n_down);
+	for (int p = 0; p < phases.rows(); ++p)
+	{
+		double sum = 0.0;
+		for (int k = 0; k < phases.cols(); ++k)
+		{
+			// distance of the output sample from the input sample of the tap
+			const double distance = static_cast<double>(p) / n_up + x_half - 1 - k;
+			const double x = pi * scale * distance, window = pi * distance / x_half;
+			const double sinc = x == 0.0 ? 1.0 : sin(x) / x;
+			phases[p][k] = sinc * (0.42 + 0.5 * cos(window) + 0.08 * cos(2 * window));
+			sum += phases[p][k];
+		}
+		for (int k = 0; k < phases.cols(); ++k)
+		{
+			phases[p][k] /= sum;
+		}
+	}
+
+	return phases;
+}
+
+vector<double> Resampler::resample(int64_t n_limit)
+{
+	vector<double> samples;
+
+	const int64_t last = first + history.size();
+	for (; n_output < n_limit; ++n_output)
+	{
+		const int64_t i = n_output * n_down / n_up;
+		if (i + x_half >= last)
+		{
+			// wait for the taps after the output sample
+			break;
+		}
+
+		const double *phase = phases[n_output * n_down % n_up];
+		const double *taps = history.data() + (i - x_half + 1 - first);
+		double sample = 0.0;
+		for (int k = 0; k < 2 * x_half; ++k)
+		{
+			sample += phase[k] * taps[k];
+		}
+		samples.push_back(sample);
+	}
+
+	// forget the input samples before the taps of the next output sample
+	const int64_t x_forget = min(n_output * n_down / n_up - x_half + 1 - first, static_cast<int64_t>(history.size()));
+	history.erase(history.begin(), history.begin() + x_forget);
+	first += x_forget;
+
+	return samples;
+}
@@ -0,0 +1,241 @@
+#include "scorer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+
+using namespace std;
+
+Scorer::Scorer(const vector<Model> &models) :
+	n_models(models.size()), n_states(setup_states(models)),
+	pi(setup_pi(models, n_states)), at(setup_at(models, n_states)), bt(setup_bt(models, n_states, setup_symbols(models))), at_bands(setup_bands(models, n_states))
+{
+}
+
+/// Parts are aligned blocks of columns, every part is scored over all observations on its own.
+vector<double> Scorer::score(const vector<int> &o, ThreadPool *thread_pool) const
+{
+	vector<double> log_Ps(n_models, 0.0);
+
+	const int n_parts = (n_models + x_part - 1) / x_part;
+	vector<future<void>> part_futures;
+	for (int i = 0; i < n_parts && thread_pool != nullptr && n_parts > 1; ++i)
+	{
+		part_futures.push_back(thread_pool->enqueue(&Scorer::score_part, this, cref(o), i, ref(log_Ps)));
+	}
+	for (int i = 0; i < n_parts; ++i)
+	{
+		if (part_futures.empty())
+		{
+			score_part(o, i, log_Ps);
+		}
+		else
+		{
+			part_futures[i].get();
+		}
+	}
+
+	return log_Ps;
+}
+
+void Scorer::step(const Matrix<double> &alpha, int o, Matrix<double> &new_alpha, vector<double> &log_Ps) const
+{
+	step(alpha, o, 0, n_models, new_alpha, log_Ps);
+}
+
+int Scorer::setup_states(const vector<Model> &models)
+{
+	int n_states = 0;
+
+	for (int m = 0; m < models.size(); ++m)
+	{
+		n_states = max(n_states, models[m].b.rows());
+	}
+
+	return n_states;
+}
+
+int Scorer::setup_symbols(const vector<Model> &models)
+{
+	int n_symbols = 0;
+
+	for (int m = 0; m < models.size(); ++m)
+	{
+		n_symbols = max(n_symbols, models[m].b.cols());
+	}
+
+	return n_symbols;
+}
+
+Matrix<double> Scorer::setup_pi(const vector<Model> &models, int n_states)
+{
+	Matrix<double> pi(n_states, models.size(), 0.0);
+
+	for (int m = 0; m < models.size(); ++m)
+	{
+		for (int i = 0; i < models[m].pi.size(); ++i)
+		{
+			pi[i][m] = models[m].pi[i];
+		}
+	}
+
+	return pi;
+}
+
+Matrix<double> Scorer::setup_at(const vector<Model> &models, int n_states)
+{
+	Matrix<double> at(n_states * n_states, models.size(), 0.0);
+
+	for (int m = 0; m < models.size(); ++m)
+	{
+		const Matrix<double> &a = models[m].a;
+		for (int i = 0; i < a.rows(); ++i)
+		{
+			for (int j = 0; j < a.cols(); ++j)
+			{
+				at[j * n_states + i][m] = a[i][j];
+			}
+		}
+	}
+
+	return at;
+}
+
+Matrix<double> Scorer::setup_bt(const vector<Model> &models, int n_states, int n_symbols)
+{
+	Matrix<double> bt(n_symbols * n_states, models.size(), 0.0);
+
+	for (int m = 0; m < models.size(); ++m)
+	{
+		const Matrix<double> &b = models[m].b;
+		for (int i = 0; i < b.rows(); ++i)
+		{
+			for (int k = 0; k < b.cols(); ++k)
+			{
+				bt[k * n_states + i][m] = b[i][k];
+			}
+		}
+	}
+
+	return bt;
+}
+
+vector<pair<int, int>> Scorer::setup_bands(const vector<Model> &models, int n_states)
+{
+	vector<pair<int, int>> bands(n_states, pair<int, int>(n_states, 0));
+
+	for (int m = 0; m < models.size(); ++m)
+	{
+		const Matrix<double> &a = models[m].a;
+		for (int i = 0; i < a.rows(); ++i)
+		{
+			for (int j = 0; j < a.cols(); ++j)
+			{
+				if (a[i][j] != 0.0)
+				{
+					bands[j].first = min(bands[j].first, i);
+					bands[j].second = max(bands[j].second, i + 1);
+				}
+			}
+		}
+	}
+	for (int i = 0; i < n_states; ++i)
+	{
+		if (bands[i].first >= bands[i].second)
+		{
+			bands[i] = pair<int, int>(0, 0);
+		}
+	}
+
+	return bands;
+}
+
+void Scorer::score_part(const vector<int> &o, int part, vector<double> &log_Ps) const
+{
+	const int begin = part * x_part, end = min(n_models, begin + x_part);
+
+	Matrix<double> alpha, new_alpha;
+	for (int t = 0; t < o.size(); ++t)
+	{
+		step(alpha, o[t], begin, end, new_alpha, log_Ps);
+		swap(alpha, new_alpha);
+	}
+}
+
+/// Alphas only keep the columns of the range, widened to the alignment, so a part does not carry the tables of all models.
+/// Columns of padded models and states stay zero, only the scales of the models in range are taken.
+/// The row after the states keeps the scales, so stepping with the same alphas allocates nothing.
+void Scorer::step(const Matrix<double> &alpha, int o, int begin, int end, Matrix<double> &new_alpha, vector<double> &log_Ps) const
+{
+	// whole rows are padded to the alignment, so the range is widened to it
+	const int lane_begin = begin / x_lanes * x_lanes, lane_end = min(pi.stride(), (end + x_lanes - 1) / x_lanes * x_lanes);
+	const int n_columns = lane_end - lane_begin;
+	if (new_alpha.rows() != n_states + 1 || new_alpha.cols() != n_columns)
+	{
+		new_alpha = Matrix<double>(n_states + 1, n_columns, 0.0);
+	}
+
+	for (int i = 0; i < n_states; ++i)
+	{
+		const double *b = bt[o * n_states + i] + lane_begin;
+		double *alpha_next = new_alpha[i];
+		if (alpha.empty())
+		{
+			const double *pi_i = pi[i] + lane_begin;
+			for (int m = 0; m < n_columns; ++m)
+			{
+				alpha_next[m] = pi_i[m] * b[m];
+			}
+			continue;
+		}
+
+		for (int m = 0; m < n_columns; ++m)
+		{
+			alpha_next[m] = 0.0;
+		}
+		for (int j = at_bands[i].first; j < at_bands[i].second; ++j)
+		{
+			const double *alpha_t = alpha[j];
+			const double *a = at[i * n_states + j] + lane_begin;
+			for (int m = 0; m < n_columns; ++m)
+			{
+				alpha_next[m] += alpha_t[m] * a[m];
+			}
+		}
+		for (int m = 0; m < n_columns; ++m)
+		{
+			alpha_next[m] *= b[m];
+		}
+	}
+
+	double *C = new_alpha[n_states];
+	for (int m = 0; m < n_columns; ++m)
+	{
+		C[m] = 0.0;
+	}
+	for (int i = 0; i < n_states; ++i)
+	{
+		const double *alpha_next = new_alpha[i];
+		for (int m = 0; m < n_columns; ++m)
+		{
+			C[m] += alpha_next[m];
+		}
+	}
+	for (int m = begin; m < end; ++m)
+	{
+		log_Ps[m] += log(C[m - lane_begin]);
+	}
+	for (int m = 0; m < n_columns; ++m)
+	{
+		// padded columns are left as zeroes
+		C[m] = C[m] == 0.0 ? 0.0 : 1 / C[m];
+	}
+	for (int i = 0; i < n_states; ++i)
+	{
+		double *alpha_next = new_alpha[i];
+		for (int m = 0; m < n_columns; ++m)
+		{
+			alpha_next[m] *= C[m];
+		}
+	}
+}
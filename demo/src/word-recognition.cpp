@@ -5,6 +5,7 @@
 #include <utility>
 #include <vector>
 
+#include "bundle.h"
 #include "config.h"
 #include "file-io.h"
 #include "logger.h"
@@ -28,7 +29,16 @@ int main()
 	const string train_folder = folder + "train/";
 	const string model_folder = folder + "model/";
 	const unique_ptr<ModelTrainer> model_trainer = ModelTrainer::Builder(train_folder, model_folder, words, config).build();
-	const unique_ptr<ModelTester> model_tester = ModelTester::Builder(model_folder, config).build();
+	// pack the trained files into one bundle and test from it
+	const string bundle_filename = model_folder + "sr-lib.bundle";
+	FileIO::set_binary_item_to_file<Bundle>(Bundle::Builder(model_folder, words, config).build(), bundle_filename);
+	const Bundle bundle = FileIO::get_mapped_item_from_file<Bundle>(bundle_filename);
+	if (bundle.empty())
+	{
+		Logger::info("Bundle could not be read:", bundle_filename);
+		return 1;
+	}
+	const unique_ptr<ModelTester> model_tester = ModelTester::Builder(model_folder, bundle.config).build(bundle.codebook, bundle.models);
 	chrono::steady_clock::time_point end = chrono::steady_clock::now();
 	chrono::milliseconds time = chrono::duration_cast<chrono::milliseconds>(end - start);
 	Logger::info("Time taken:", time.count(), "ms");
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "binary.h"
+#include "codebook.h"
+#include "config.h"
+#include "model.h"
+#include "n-gram.h"
+
+/// Everything a recogniser needs packed into one binary container, so that it is opened with a single map.
+/// Matrices of the codebook and the models view the mapping, nothing is parsed.
+struct Bundle
+{
+public:
+	class Builder
+	{
+	public:
+		/// Constructor.
+		Builder(const std::string &model_folder, const std::vector<std::string> &words, const Config &config);
+
+		/// Build the Bundle from the trained files of the model folder.
+		Bundle build() const;
+
+	private:
+		const std::string model_folder;
+		const std::vector<std::string> words;
+		const Config config;
+	};
+
+	Config config;
+	std::vector<std::string> words;
+	Codebook codebook;
+	std::vector<Model> models;
+	std::vector<Gram> grams;
+
+	/// Return whether empty.
+	bool empty() const;
+
+	/// Operators for loading and saving.
+	friend BinaryReader &operator>>(BinaryReader &input, Bundle &bundle);
+	friend BinaryWriter &operator<<(BinaryWriter &output, const Bundle &bundle);
+};
@@ -10,6 +10,7 @@
 
 /// Config keys
 /// q_cache      (bool):    whether cached training files should be used
+/// q_binary     (bool):    whether trained files should be written as mapped binary containers
 /// n_thread     (int):     number of threads used for parallel execution
 /// q_trim       (bool):    whether the samples should be trimmed for background noise
 /// x_frame      (int):     number of samples in a frame
@@ -19,13 +20,28 @@
 /// q_gain       (bool):    whether gain term should be added to features
 /// q_delta      (bool):    whether delta terms should be added to features
 /// q_accel      (bool):    whether accel terms should be added to features
+/// n_filters    (int):     number of mel filters
+/// n_fft        (int):     number of points in fft, rounded up to a power of two of at least x_frame
+/// hz_low       (double):  lowest frequency of mel filters
+/// hz_high      (double):  highest frequency of mel filters
+/// hz_sampling  (double):  sampling rate of the samples, wav files at other rates are resampled
 /// x_codebook   (int):     size of codebook
+/// q_hamerly    (bool):    whether kmeans should skip distances using hamerly bounds
+/// x_batch      (int):     size of codebook mini batches, 0 keeps universe in memory
+/// p_sample     (double):  probability of a feature being sampled into a mini batch
 /// n_state      (int):     number of states in HMM
 /// n_bakis      (int):     connentedness of initial bakis model for HMM
-/// n_retrain    (int):     number of times each model should be trained
+/// q_band       (bool):    whether HMM should keep the bakis band and skip the rest
+/// emission     (string):  "discrete" codebook, "gaussian" mixture or "semi" continuous emissions of HMM
+/// n_mixture    (int):     number of gaussian mixtures per state
+/// n_top        (int):     number of most likely codebook gaussians per feature for semi continuous HMM
+/// beam         (double):  log score below the best token where decoding prunes tokens
+/// x_active     (int):     maximum active tokens while decoding, 0 for no cap
+/// n_best       (int):     number of best words returned by decoding
 /// n_gram       (int):     number of previous words to be considered for prediction
 /// q_dfa        (bool):    command based word prediction or probability based
 /// gram_weight  (double):  linear weight for the final scoring with recognition result
+/// gram_scale   (double):  scale of log gram scores at connected word boundaries
 /// cutoff_score (double):  cutoff for final score
 
 struct Config
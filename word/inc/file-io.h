@@ -1,18 +1,63 @@
 #pragma once
 
+#include <cstddef>
 #include <fstream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "binary.h"
 #include "io.h"
 
 namespace FileIO
 {
-	/// Get the item from the given file.
+	/// Map the given file read only, along with its size, the mapping is empty if the file can not be mapped.
+	/// The file is unmapped when the last copy of the pointer is gone.
+	std::pair<std::shared_ptr<const char>, std::size_t> map_file(const std::string &filename);
+
+	/// Set the characters to the given file, written aside and renamed over it so that mappings of the old file keep its contents.
+	/// Return whether the file could be written.
+	bool set_chars_to_file(const std::string &chars, const std::string &filename);
+
+	/// Return whether the given file can be opened for reading.
+	inline bool exists(const std::string &filename)
+	{
+		return std::ifstream(filename).good();
+	}
+
+	/// Get the characters of the given file with a single read, along with whether it could be read.
+	inline std::pair<bool, std::string> get_chars_from_file(const std::string &filename)
+	{
+		std::pair<bool, std::string> chars(false, std::string());
+
+		std::ifstream stream(filename, std::ios::binary | std::ios::ate);
+		if (!stream.good())
+		{
+			return chars;
+		}
+
+		chars.second.resize(static_cast<std::size_t>(stream.tellg()));
+		stream.seekg(0);
+		stream.read(&chars.second[0], chars.second.size());
+		chars.first = stream.good();
+
+		return chars;
+	}
+
+	/// Get the item from the given file, the item reads from a stream over the characters of the file.
 	template <typename T>
 	inline T get_item_from_file(const std::string &filename)
 	{
-		std::ifstream stream(filename, std::ios::binary);
+		const std::pair<bool, std::string> chars = get_chars_from_file(filename);
+		IO::CharsBuffer buffer(chars.second.data(), chars.second.data() + chars.second.size());
+		std::istream stream(&buffer);
+		if (!chars.first)
+		{
+			// same as a stream of a missing file
+			stream.setstate(std::ios::failbit);
+		}
 
 		return IO::get_item_from_stream<T>(stream);
 	}
@@ -21,44 +66,102 @@ namespace FileIO
 	template <typename T>
 	inline void set_item_to_file(const T &item, const std::string &filename)
 	{
-		std::ofstream stream(filename, std::ios::binary);
-
-		stream << IO::get_string_from_item<T>(item);
+		set_chars_to_file(IO::get_string_from_item<T>(item), filename);
 	}
 
 	/// Get the vector from the given file.
 	template <typename T>
 	inline std::vector<T> get_vector_from_file(const std::string &filename, char delim = '\n')
 	{
-		std::ifstream stream(filename, std::ios::binary);
+		const std::pair<bool, std::string> chars = get_chars_from_file(filename);
 
-		return IO::get_vector_from_stream<T>(stream, delim);
+		return IO::get_vector_from_chars<T>(chars.second.data(), chars.second.data() + chars.second.size(), delim);
 	}
 
 	/// Set the vector to the given file.
 	template <typename T>
 	inline void set_vector_to_file(const std::vector<T> &vec, const std::string &filename, char delim = '\n')
 	{
-		std::ofstream stream(filename, std::ios::binary);
-
-		stream << IO::get_string_from_vector<T>(vec, delim);
+		set_chars_to_file(IO::get_string_from_vector<T>(vec, delim), filename);
 	}
 
 	/// Get the matrix from the given file.
 	template <typename T>
 	inline std::vector<std::vector<T>> get_matrix_from_file(const std::string &filename, char delim_token = ',', char delim_line = '\n')
 	{
-		std::ifstream stream(filename, std::ios::binary);
+		const std::pair<bool, std::string> chars = get_chars_from_file(filename);
 
-		return IO::get_matrix_from_stream<T>(stream, delim_token, delim_line);
+		return IO::get_matrix_from_chars<T>(chars.second.data(), chars.second.data() + chars.second.size(), delim_token, delim_line);
 	}
 
 	/// Set the matrix to the given file.
 	template <typename T>
 	inline void set_matrix_to_file(const std::vector<std::vector<T>> &mat, const std::string &filename, char delim_token = ',', char delim_line = '\n')
 	{
-		std::ofstream stream(filename, std::ios::binary);
+		set_chars_to_file(IO::get_string_from_matrix(mat, delim_token, delim_line), filename);
+	}
+
+	/// Get the item from the given binary container, mapped and read in place, empty if the file is not a sound container.
+	template <typename T>
+	inline T get_mapped_item_from_file(const std::string &filename)
+	{
+		const std::pair<std::shared_ptr<const char>, std::size_t> mapping = map_file(filename);
 
-		stream << IO::get_string_from_matrix(mat, delim_token, delim_line);
+		T item;
+		BinaryReader reader(mapping.first, mapping.second);
+		reader >> item;
+
+		return reader.valid() ? item : T();
+	}
+
+	/// Get the item from the given file, a binary container is mapped and read in place while other files are parsed as text from the mapping.
+	template <typename T>
+	inline T get_binary_item_from_file(const std::string &filename)
+	{
+		const std::pair<std::shared_ptr<const char>, std::size_t> mapping = map_file(filename);
+		if (mapping.first == nullptr || !Binary::sniff(mapping.first.get(), mapping.second))
+		{
+			IO::CharsBuffer buffer(mapping.first.get(), mapping.first.get() + mapping.second);
+			std::istream stream(&buffer);
+			if (mapping.first == nullptr)
+			{
+				// same as a stream of a missing file
+				stream.setstate(std::ios::failbit);
+			}
+
+			return IO::get_item_from_stream<T>(stream);
+		}
+
+		T item;
+		BinaryReader reader(mapping.first, mapping.second);
+		reader >> item;
+
+		return reader.valid() ? item : T();
+	}
+
+	/// Set the item to the given file as a binary container.
+	template <typename T>
+	inline void set_binary_item_to_file(const T &item, const std::string &filename)
+	{
+		BinaryWriter writer;
+		writer << item;
+		std::ostringstream stream(std::ios::binary);
+		stream << writer;
+
+		set_chars_to_file(stream.str(), filename);
+	}
+
+	/// Set the item to the given file, as a binary container if asked.
+	template <typename T>
+	inline void set_item_to_file(const T &item, const std::string &filename, bool q_binary)
+	{
+		if (q_binary)
+		{
+			set_binary_item_to_file<T>(item, filename);
+		}
+		else
+		{
+			set_item_to_file<T>(item, filename);
+		}
 	}
 }
@@ -20,25 +20,41 @@ public:
 		/// Build the GramTester.
 		std::unique_ptr<GramTester> build() const;
 
+		/// Build the GramTester with the given grams instead of loading them.
+		std::unique_ptr<GramTester> build(const std::vector<Gram> &grams) const;
+
+		/// Build the GramTester with the given grams, which can also score the words by their indices.
+		std::unique_ptr<GramTester> build(const std::vector<Gram> &grams, const std::vector<std::string> &words) const;
+
+		/// Load the grams.
+		std::vector<Gram> get_grams() const;
+
 	private:
 		static constexpr char const *gram_ext = ".gram";
 
 		const std::string model_folder;
 		const int n_gram;
 		const bool q_dfa;
-
-		/// Load the grams. 
-		std::vector<Gram> get_grams() const;
 	};
 
 	/// Get the gram score.
 	std::pair<bool, double> test(const std::vector<std::string> &context, const std::string &word) const;
 
+	/// Get the gram score by the indices of the words the tester was built with.
+	std::pair<bool, double> test(const std::vector<int> &context, int word) const;
+
+	/// Get the number of latest words of a context which decide the score, older words make no difference.
+	int x_context() const;
+
 private:
 	const int n_gram;
 	const bool q_dfa;
 	const MLE mle;
 
+	/// Get the gram score of the word after the context words which are allowed.
+	template <typename T>
+	std::pair<bool, double> get_score(const std::vector<T> &full_context, const T &word) const;
+
 	/// Constructor.
 	GramTester(int n_gram, bool q_dfa, MLE mle);
 };
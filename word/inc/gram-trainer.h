@@ -24,6 +24,7 @@ public:
 		const std::string model_folder;
 		const std::vector<std::vector<std::string>> sentences;
 		const bool q_cache;
+		const bool q_binary;
 		const int n_thread;
 		const int n_gram;
 		const bool q_dfa;
@@ -41,12 +42,13 @@ private:
 	const std::string model_folder;
 	const std::vector<std::vector<std::string>> sentences;
 	const bool q_cache;
+	const bool q_binary;
 	const std::unique_ptr<ThreadPool> thread_pool;
 	const int n_gram;
 	const bool q_dfa;
 
 	/// Constructor.
-	GramTrainer(std::string model_folder, std::vector<std::vector<std::string>> sentences, bool q_cache, std::unique_ptr<ThreadPool> thread_pool, int n_gram, bool q_dfa);
+	GramTrainer(std::string model_folder, std::vector<std::vector<std::string>> sentences, bool q_cache, bool q_binary, std::unique_ptr<ThreadPool> thread_pool, int n_gram, bool q_dfa);
 
 	/// Get the gram for given n.
 	Gram get_gram(int n) const;
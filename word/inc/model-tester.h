@@ -7,9 +7,12 @@
 
 #include "codebook.h"
 #include "config.h"
+#include "decoder.h"
 #include "feature.h"
+#include "hmm.h"
 #include "model.h"
 #include "preprocess.h"
+#include "scorer.h"
 #include "threads.h"
 
 class ModelTester
@@ -24,6 +27,15 @@ public:
 		/// Build the ModelTester.
 		std::unique_ptr<ModelTester> build() const;
 
+		/// Build the ModelTester with the given codebook and models instead of loading them.
+		std::unique_ptr<ModelTester> build(const Codebook &codebook, const std::vector<Model> &models) const;
+
+		/// Load the codebook.
+		Codebook get_codebook() const;
+
+		/// Load the models.
+		std::vector<Model> get_models() const;
+
 	private:
 		static constexpr char const *codebook_ext = "sr-lib.codebook";
 		static constexpr char const *model_ext = ".model";
@@ -38,35 +50,98 @@ public:
 		const bool q_gain;
 		const bool q_delta;
 		const bool q_accel;
+		const int n_filters;
+		const int n_fft;
+		const double hz_low;
+		const double hz_high;
+		const double hz_sampling;
+		const double beam;
+		const int x_active;
+		const int n_best;
+		const std::string emission;
+		const int n_top;
 
 		/// Initialise cepstral.
 		std::unique_ptr<ICepstral> get_cepstral() const;
+	};
 
-		/// Load the codebook.
-		Codebook get_codebook() const;
+	/// Score all models frame by frame while the samples are being pushed.
+	class Session
+	{
+	public:
+		/// Constructor.
+		Session(const ModelTester &model_tester);
 
-		/// Load the models.
-		std::vector<Model> get_models() const;
+		/// Push the samples and advance all models by the complete observations.
+		void push(const std::vector<double> &samples);
+
+		/// Advance all models by the remaining observations.
+		void flush();
+
+		/// Return the current scores for all models.
+		std::pair<bool, std::vector<double>> scores() const;
+
+		/// Return the current best model indices.
+		std::vector<int> best(int n_best) const;
+
+	private:
+		const ModelTester &model_tester;
+		Preprocessor::Stream preprocessor_stream;
+		ICepstral::Stream cepstral_stream;
+		int n_observations;
+		Matrix<double> alpha;
+		Matrix<double> new_alpha;
+		std::vector<std::vector<double>> alphas;
+		std::vector<double> workspace;
+		std::vector<double> log_Ps;
+
+		/// Advance all models by the observations of given frames.
+		void advance(const std::vector<std::vector<double>> &frames, bool q_flush);
 	};
 
 	/// Return the scores for all models.
 	std::pair<bool, std::vector<double>> test(const std::string &filename) const;
 
+	/// Return the best model indices along with their scores, decoded with a beam.
+	std::pair<bool, std::vector<std::pair<int, double>>> decode(const std::string &filename) const;
+
+	/// Return the best sequence of model indices for connected words, decoded with a beam and the language scores of the latest x_history models.
+	std::pair<bool, std::vector<int>> decode(const std::string &filename, const Decoder::LanguageScore &language_score, int x_history) const;
+
 private:
 	static constexpr char const *wav_ext = ".wav";
 
 	const std::unique_ptr<ThreadPool> thread_pool;
 	const Preprocessor preprocessor;
 	const std::unique_ptr<ICepstral> cepstral;
-	const Codebook codebook;
-	const std::vector<Model> models;
+	const int hz_sampling;
+	const Quantiser quantiser;
+	const GMM gmm;
+	const std::vector<HMM> hmms;
+	const bool q_continuous;
+	const bool q_semi;
+	const int n_top;
+	const Scorer scorer;
+	const Decoder decoder;
 
 	/// Constructor.
-	ModelTester(std::unique_ptr<ThreadPool> thread_pool, Preprocessor preprocessor, std::unique_ptr<ICepstral> cepstral, Codebook codebook, std::vector<Model> models);
+	ModelTester(std::unique_ptr<ThreadPool> thread_pool, Preprocessor preprocessor, std::unique_ptr<ICepstral> cepstral, int hz_sampling, Codebook codebook, std::vector<Model> models, double beam, int x_active, int n_best, bool q_continuous, bool q_semi, int n_top);
+
+	/// Get the densities of the features over the codebook for semi continuous models, empty otherwise.
+	Densities get_densities(const Features &features) const;
+
+	/// Get the emissions of the features or their densities for the continuous model.
+	std::pair<std::vector<double>, Matrix<double>> get_emissions(int model_index, const Features &features, const Densities &densities) const;
+
+	/// Score the features or their densities with the continuous model.
+	double get_score(int model_index, const Features &features, const Densities &densities) const;
+
+	/// Get the log emissions of the features or their densities for all continuous models.
+	std::vector<Matrix<double>> get_log_emissions(const Features &features, const Densities &densities) const;
 
-	/// Get the observations sequence from the codebook.
+	/// Get the observations sequence from the quantiser of the codebook.
 	std::vector<int> get_observations(const std::string &filename) const;
 
 	/// Load and preprocess the samples, and return their features.
-	std::vector<Feature> get_features(const std::string &filename) const;
+	Features get_features(const std::string &filename) const;
 };
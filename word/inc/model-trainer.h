@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -28,6 +29,7 @@ public:
 		const std::string model_folder;
 		const std::vector<std::string> words;
 		const bool q_cache;
+		const bool q_binary;
 		const int n_thread;
 		const bool q_trim;
 		const int x_frame;
@@ -37,10 +39,21 @@ public:
 		const bool q_gain;
 		const bool q_delta;
 		const bool q_accel;
+		const int n_filters;
+		const int n_fft;
+		const double hz_low;
+		const double hz_high;
+		const double hz_sampling;
 		const int x_codebook;
+		const bool q_hamerly;
+		const int x_batch;
+		const double p_sample;
 		const int n_state;
 		const int n_bakis;
-		const int n_retrain;
+		const bool q_band;
+		const std::string emission;
+		const int n_mixture;
+		const int n_top;
 
 		/// Initialise cepstral.
 		std::unique_ptr<ICepstral> get_cepstral() const;
@@ -61,34 +74,64 @@ private:
 	const std::string model_folder;
 	const std::vector<std::string> words;
 	const bool q_cache;
+	const bool q_binary;
 	const std::unique_ptr<ThreadPool> thread_pool;
 	const Preprocessor preprocessor;
 	const std::unique_ptr<ICepstral> cepstral;
+	const int hz_sampling;
 	const LBG lbg;
 	const Model::Builder model_builder;
-	const int n_retrain;
+	const bool q_stream;
+	const bool q_band;
+	const bool q_continuous;
+	const bool q_semi;
+	const int n_top;
 
 	/// Constructor.
-	ModelTrainer(std::string train_folder, std::string model_folder, std::vector<std::string> words, bool q_cache, std::unique_ptr<ThreadPool> thread_pool, Preprocessor preprocessor, std::unique_ptr<ICepstral> cepstral, LBG lbg, Model::Builder model_builder, int n_retrain);
+	ModelTrainer(std::string train_folder, std::string model_folder, std::vector<std::string> words, bool q_cache, bool q_binary, std::unique_ptr<ThreadPool> thread_pool, Preprocessor preprocessor, std::unique_ptr<ICepstral> cepstral, int hz_sampling, LBG lbg, Model::Builder model_builder, bool q_stream, bool q_band, bool q_continuous, bool q_semi, int n_top);
 
 	/// Build the codebook using lbg.
 	Codebook get_codebook() const;
 
 	/// Build the universe by accumulating features from all words.
-	std::vector<Feature> get_universe() const;
+	Features get_universe() const;
 
 	/// Build the word universe by accumulating features from all utterances.
-	std::vector<Feature> get_word_universe(int word_index) const;
+	Features get_word_universe(int word_index) const;
+
+	/// Cache the features of all utterances of the word and return their filenames.
+	std::vector<std::string> get_word_features_filenames(int word_index) const;
+
+	/// Get the filename of the wav of the utterance.
+	std::string get_wav_filename(int utterance_index, int word_index) const;
+
+	/// Get the filename where features of the utterance are cached.
+	std::string get_features_filename(int utterance_index, int word_index) const;
 
 	/// Load and preprocess the samples, and return their features.
-	std::vector<Feature> get_features(int utterance_index, int word_index) const;
+	Features get_features(int utterance_index, int word_index) const;
+
+	/// Get the model for given word index by optimising over the observations of all its utterances.
+	Model get_word_model(int word_index, const std::vector<std::vector<int>> &observations) const;
+
+	/// Get the continuous model for given word index by optimising over the features of all its utterances.
+	Model get_word_model(int word_index, const std::vector<Features> &features) const;
+
+	/// Get the semi continuous model for given word index by optimising over the densities of all its utterances.
+	Model get_word_model(int word_index, const std::vector<Densities> &densities) const;
+
+	/// Get the model for given word index from the cache, or optimise and cache it.
+	Model get_word_model(int word_index, const std::function<Model()> &optimise) const;
+
+	/// Get the features of all utterances of the word.
+	std::vector<Features> get_word_features(int word_index) const;
 
-	/// Get the model for given word index.
-	Model get_word_model(int word_index, const Codebook &codebook) const;
+	/// Get the densities of all utterances of the word over the gaussians of the codebook.
+	std::vector<Densities> get_word_densities(int word_index, const GMM &gmm) const;
 
-	/// Optimise the train model using the observations from utterances of the given filename.
-	Model get_utterance_model(int word_index, const Model &train_model, const Codebook &codebook) const;
+	/// Get the observations sequences of all utterances of the word.
+	std::vector<std::vector<int>> get_word_observations(int word_index, const Quantiser &quantiser) const;
 
-	/// Get the observations sequence from the codebook.
-	std::vector<int> get_observations(int utterance_index, int word_index, const Codebook &codebook) const;
+	/// Get the observations sequence from the quantiser of the codebook.
+	std::vector<int> get_observations(int utterance_index, int word_index, const Quantiser &quantiser) const;
 };
@@ -5,6 +5,7 @@
 #include <utility>
 #include <vector>
 
+#include "bundle.h"
 #include "config.h"
 #include "gram-tester.h"
 #include "model-tester.h"
@@ -18,21 +19,33 @@ public:
 		/// Constructor.
 		Builder(const std::string &model_folder, const std::vector<std::string> &words, const std::vector<std::vector<std::string>> &sentences, const Config &config);
 
-		/// Build the Recogniser.
+		/// Constructor, the words, config, codebook, models and grams are all taken from the bundle file.
+		Builder(const std::string &bundle_filename);
+
+		/// Build the Recogniser, null if the bundle could not be read.
 		std::unique_ptr<Recogniser> build() const;
 
 	private:
+		const bool q_bundle;
+		const Bundle bundle;
 		const std::string model_folder;
 		const std::vector<std::string> words;
 		const std::vector<std::vector<std::string>> sentences;
 		const Config config;
 		const double gram_weight;
+		const double gram_scale;
 		const double cutoff_score;
+
+		/// Constructor.
+		Builder(const Bundle &bundle);
 	};
 
 	/// Recognise the word with previous context.
 	std::pair<bool, std::string> recognise(const std::string &filename);
 
+	/// Recognise the connected words with previous context in a single search.
+	std::pair<bool, std::vector<std::string>> recognise_sentence(const std::string &filename);
+
 	/// Clear the context.
 	void reset();
 
@@ -42,9 +55,10 @@ private:
 	const std::unique_ptr<ModelTester> model_tester;
 	const std::unique_ptr<GramTester> gram_tester;
 	const double gram_weight;
+	const double gram_scale;
 	const double cutoff_score;
-	std::vector<std::string> context;
+	std::vector<int> context;
 
 	/// Constructor.
-	Recogniser(std::vector<std::string> words, std::vector<std::vector<std::string>> sentences, std::unique_ptr<ModelTester> model_tester, std::unique_ptr<GramTester> gram_tester, double gram_weight, double cutoff_score);
+	Recogniser(std::vector<std::string> words, std::vector<std::vector<std::string>> sentences, std::unique_ptr<ModelTester> model_tester, std::unique_ptr<GramTester> gram_tester, double gram_weight, double gram_scale, double cutoff_score);
 };
@@ -1,78 +1,93 @@
 #pragma once
 
-#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
-#include <string>
+#include <memory>
 #include <vector>
 
 /// http://soundfile.sapp.org/doc/WaveFormat/
-/// Works with only PCM 16 bit uncompressed little endian wav files.
-struct Wav
+/// Works with 8, 16, 24 and 32 bit PCM and 32 bit float little endian wav files, channels are mixed down to one.
+/// The chunks are walked from the header so that chunks other than fmt and data, such as LIST, are skipped.
+/// The samples are viewed in place in the file data and scaled to the range of 16 bit samples when converted.
+/// Mono 16 bit samples are converted by a kernel chosen at runtime from avx2 and scalar variants.
+class Wav
 {
 public:
-	/// Get the samples.
+	/// Constructor.
+	Wav();
+
+	/// Constructor, the format is checked and the samples are viewed in the data which is kept alive along with the wav.
+	Wav(std::shared_ptr<const char> data, std::size_t size);
+
+	/// Return whether the data is a wav which can be read.
+	bool valid() const;
+
+	/// Get the sampling rate in hertz.
+	int rate() const;
+
+	/// Get the number of channels.
+	int channels() const;
+
+	/// Get the number of frames, each has a sample of all channels.
+	int size() const;
+
+	/// Get the samples as they are in the file if they are 16 bit, null otherwise.
+	const std::int16_t *data() const;
+
+	/// Convert the mixed down samples into the given buffer, which has room for all frames.
+	void samples(double *buffer) const;
+	void samples(float *buffer) const;
+
+	/// Get the mixed down samples.
 	template <typename T>
 	inline std::vector<T> samples() const
 	{
-		std::vector<T> samples;
+		std::vector<T> buffer(n_frames);
+		samples(buffer.data());
 
-		// data should be initialized so that it does not have garbage size
-		for (int i = 0; i < data.size(); ++i)
-		{
-			samples.push_back(0x8000 & data[i] ? static_cast<int>((0x7FFF & data[i])) - 0x8000 : data[i]);
-		}
-
-		return samples;
+		return buffer;
 	}
 
-	/// Operator for loading.
-	friend std::istream &operator>>(std::istream &input, Wav &wav)
-	{
-		if (!input.good())
-		{
-			return input;
-		}
-
-		input.read(reinterpret_cast<char *>(&wav.chunk_id[0]), wav.chunk_id.size() * sizeof(wav.chunk_id[0]));
-		input.read(reinterpret_cast<char *>(&wav.chunk_size), sizeof(wav.chunk_size));
-		input.read(reinterpret_cast<char *>(&wav.format[0]), wav.format.size() * sizeof(wav.format[0]));
-
-		input.read(reinterpret_cast<char *>(&wav.subchunk1_id[0]), wav.subchunk1_id.size() * sizeof(wav.subchunk1_id[0]));
-		input.read(reinterpret_cast<char *>(&wav.subchunk1_size), sizeof(wav.subchunk1_size));
-		input.read(reinterpret_cast<char *>(&wav.audio_format), sizeof(wav.audio_format));
-		input.read(reinterpret_cast<char *>(&wav.num_channels), sizeof(wav.num_channels));
-		input.read(reinterpret_cast<char *>(&wav.sample_rate), sizeof(wav.sample_rate));
-		input.read(reinterpret_cast<char *>(&wav.byte_rate), sizeof(wav.byte_rate));
-		input.read(reinterpret_cast<char *>(&wav.block_align), sizeof(wav.block_align));
-		input.read(reinterpret_cast<char *>(&wav.bits_per_sample), sizeof(wav.bits_per_sample));
-
-		input.read(reinterpret_cast<char *>(&wav.subchunk2_id[0]), wav.subchunk2_id.size() * sizeof(wav.subchunk2_id[0]));
-		input.read(reinterpret_cast<char *>(&wav.subchunk2_size), sizeof(wav.subchunk2_size));
-
-		wav.data.resize(wav.subchunk2_size / 2);
-		input.read(reinterpret_cast<char *>(&wav.data[0]), wav.data.size() * sizeof(wav.data[0]));
-
-		return input;
-	}
+	/// Get the mixed down samples at the given sampling rate, converted and resampled a block at a time.
+	std::vector<double> resample(int hz_output) const;
+
+	/// Operator for loading, the rest of the stream is read into memory.
+	friend std::istream &operator>>(std::istream &input, Wav &wav);
 
 private:
-	// RIFF
-	std::array<char, 4> chunk_id;
-	uint32_t chunk_size;
-	std::array<char, 4> format;
-
-	// fmt
-	std::array<char, 4> subchunk1_id;
-	uint32_t subchunk1_size;
-	uint16_t audio_format;
-	uint16_t num_channels;
-	uint32_t sample_rate;
-	uint32_t byte_rate;
-	uint16_t block_align;
-	uint16_t bits_per_sample;
-
-	// data
-	std::array<char, 4> subchunk2_id;
-	uint32_t subchunk2_size;
-	std::vector<uint16_t> data;
+	typedef void (*DoubleKernel)(const std::int16_t *pcm, int n_samples, double *values);
+	typedef void (*FloatKernel)(const std::int16_t *pcm, int n_samples, float *values);
+
+	static constexpr std::uint16_t pcm_format = 1;
+	static constexpr std::uint16_t float_format = 3;
+	static constexpr std::uint16_t extensible_format = 0xFFFE;
+	static constexpr int x_block = 4096;
+
+	std::shared_ptr<const char> values;
+	int n_frames;
+	int n_channels;
+	int hz_sampling;
+	int x_sample;
+	bool q_float;
+
+	/// Walk the chunks to the format and the samples, the wav is left empty if they are not sound.
+	bool setup(const std::shared_ptr<const char> &data, std::size_t size);
+
+	/// Convert the mixed down samples of the given frames.
+	template <typename T, typename Kernel>
+	void convert(int begin, int end, T *buffer, Kernel kernel) const;
+
+	/// Get the sample at the given bytes, scaled to the range of 16 bit samples.
+	double get_sample(const char *bytes) const;
+
+	/// Read a little endian value.
+	template <typename T>
+	static T get_value(const char *bytes);
+
+	/// Convert the samples.
+	static void scalar_kernel(const std::int16_t *pcm, int n_samples, double *values);
+	static void scalar_kernel(const std::int16_t *pcm, int n_samples, float *values);
+	static void avx2_kernel(const std::int16_t *pcm, int n_samples, double *values);
+	static void avx2_kernel(const std::int16_t *pcm, int n_samples, float *values);
 };
@@ -0,0 +1,71 @@
+#include "bundle.h"
+
+#include <sstream>
+
+#include "gram-tester.h"
+#include "io.h"
+#include "model-tester.h"
+
+using namespace std;
+
+Bundle::Builder::Builder(const string &model_folder, const vector<string> &words, const Config &config) :
+	model_folder(model_folder), words(words), config(config)
+{
+}
+
+Bundle Bundle::Builder::build() const
+{
+	const ModelTester::Builder model_tester_builder(model_folder, config);
+	const GramTester::Builder gram_tester_builder(model_folder, config);
+
+	return Bundle{ config, words, model_tester_builder.get_codebook(), model_tester_builder.get_models(), gram_tester_builder.get_grams() };
+}
+
+bool Bundle::empty() const
+{
+	return words.empty() || models.empty();
+}
+
+/// The numbers of models and grams come first, the config and the words are kept in their text forms.
+BinaryReader &operator>>(BinaryReader &input, Bundle &bundle)
+{
+	vector<int> sizes;
+	string config, words;
+	input >> sizes >> config >> words >> bundle.codebook;
+	if (!input.valid() || sizes.size() != 2 || sizes[0] < 0 || sizes[1] < 0)
+	{
+		return input;
+	}
+
+	stringstream config_stream(config), words_stream(words);
+	config_stream >> bundle.config;
+	bundle.words = IO::get_vector_from_stream<string>(words_stream, '\n');
+	bundle.models = vector<Model>(sizes[0]);
+	for (int i = 0; i < sizes[0]; ++i)
+	{
+		input >> bundle.models[i];
+	}
+	bundle.grams = vector<Gram>(sizes[1]);
+	for (int i = 0; i < sizes[1]; ++i)
+	{
+		input >> bundle.grams[i];
+	}
+
+	return input;
+}
+
+BinaryWriter &operator<<(BinaryWriter &output, const Bundle &bundle)
+{
+	output << vector<int>{ static_cast<int>(bundle.models.size()), static_cast<int>(bundle.grams.size()) };
+	output << IO::get_string_from_item<Config>(bundle.config) << IO::get_string_from_vector<string>(bundle.words, '\n') << bundle.codebook;
+	for (int i = 0; i < bundle.models.size(); ++i)
+	{
+		output << bundle.models[i];
+	}
+	for (int i = 0; i < bundle.grams.size(); ++i)
+	{
+		output << bundle.grams[i];
+	}
+
+	return output;
+}
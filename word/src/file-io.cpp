@@ -0,0 +1,97 @@
+#include "file-io.h"
+
+#include <cstdio>
+
+#include "logger.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/// Rewriting a mapped file in place would change or cut the rows viewed in it, the renamed file leaves the old one to its mappings.
+bool FileIO::set_chars_to_file(const string &chars, const string &filename)
+{
+	const string temporary_filename = filename + ".tmp";
+	ofstream stream(temporary_filename, ios::binary);
+	stream.write(chars.data(), chars.size());
+	stream.close();
+
+#if defined(_WIN32)
+	const bool q_written = !stream.fail() && MoveFileExA(temporary_filename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	const bool q_written = !stream.fail() && rename(temporary_filename.c_str(), filename.c_str()) == 0;
+#endif
+	if (!q_written)
+	{
+		remove(temporary_filename.c_str());
+		Logger::info("File could not be written:", filename);
+	}
+
+	return q_written;
+}
+
+#if defined(_WIN32)
+pair<shared_ptr<const char>, size_t> FileIO::map_file(const string &filename)
+{
+	pair<shared_ptr<const char>, size_t> mapping(nullptr, 0);
+
+	const HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return mapping;
+	}
+
+	LARGE_INTEGER size;
+	const HANDLE file_mapping = GetFileSizeEx(file, &size) && size.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	const void *view = file_mapping != nullptr ? MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	// the view keeps the file open
+	if (file_mapping != nullptr)
+	{
+		CloseHandle(file_mapping);
+	}
+	CloseHandle(file);
+	if (view == nullptr)
+	{
+		return mapping;
+	}
+
+	mapping.first = shared_ptr<const char>(static_cast<const char *>(view), [](const char *data) { UnmapViewOfFile(data); });
+	mapping.second = size.QuadPart;
+
+	return mapping;
+}
+#else
+pair<shared_ptr<const char>, size_t> FileIO::map_file(const string &filename)
+{
+	pair<shared_ptr<const char>, size_t> mapping(nullptr, 0);
+
+	const int file = open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return mapping;
+	}
+
+	struct stat status;
+	void *view = fstat(file, &status) == 0 && status.st_size > 0 ? mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+	// the mapping keeps the file open
+	close(file);
+	if (view == MAP_FAILED)
+	{
+		return mapping;
+	}
+
+	const size_t size = status.st_size;
+	mapping.first = shared_ptr<const char>(static_cast<const char *>(view), [size](const char *data) { munmap(const_cast<char *>(data), size); });
+	mapping.second = size;
+
+	return mapping;
+}
+#endif
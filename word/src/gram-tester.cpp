@@ -1,5 +1,6 @@
 #include "gram-tester.h"
 
+#include <algorithm>
 #include <limits>
 
 #include "file-io.h"
@@ -15,8 +16,17 @@ GramTester::Builder::Builder(const string &model_folder, const Config &config) :
 
 unique_ptr<GramTester> GramTester::Builder::build() const
 {
-	vector<Gram> grams = get_grams();
-	return unique_ptr<GramTester>(new GramTester(grams.size() - 1, q_dfa, MLE(grams)));
+	return build(get_grams());
+}
+
+unique_ptr<GramTester> GramTester::Builder::build(const vector<Gram> &grams) const
+{
+	return build(grams, vector<string>());
+}
+
+unique_ptr<GramTester> GramTester::Builder::build(const vector<Gram> &grams, const vector<string> &words) const
+{
+	return unique_ptr<GramTester>(new GramTester(grams.size() - 1, q_dfa, MLE(grams, words)));
 }
 
 vector<Gram> GramTester::Builder::get_grams() const
@@ -27,7 +37,7 @@ vector<Gram> GramTester::Builder::get_grams() const
 	{
 		Logger::log("Loading gram:", i);
 		const string gram_filename = model_folder + to_string(i) + gram_ext;
-		const Gram gram = FileIO::get_item_from_file<Gram>(gram_filename);
+		const Gram gram = FileIO::get_binary_item_from_file<Gram>(gram_filename);
 		if (gram.empty())
 		{
 			// case when n_gram was set to maximum because q_dfa was true
@@ -40,14 +50,36 @@ vector<Gram> GramTester::Builder::get_grams() const
 	return grams;
 }
 
-pair<bool, double> GramTester::test(const vector<string> &full_context, const string &word) const
+pair<bool, double> GramTester::test(const vector<string> &context, const string &word) const
+{
+	return get_score(context, word);
+}
+
+pair<bool, double> GramTester::test(const vector<int> &context, int word) const
+{
+	return get_score(context, word);
+}
+
+/// Contexts as long as the grams are illegal with dfa, so one more word is needed to tell.
+int GramTester::x_context() const
+{
+	return max(q_dfa ? n_gram : n_gram - 1, 0);
+}
+
+GramTester::GramTester(int n_gram, bool q_dfa, MLE mle) :
+	n_gram(n_gram), q_dfa(q_dfa), mle(mle)
+{
+}
+
+template <typename T>
+pair<bool, double> GramTester::get_score(const vector<T> &full_context, const T &word) const
 {
 	pair<bool, double> score(false, 0.0);
 
-	vector<string> context;
+	vector<T> context;
 	if (full_context.size() < n_gram)
 	{
-		context = vector<string>(full_context.begin(), full_context.end());
+		context = vector<T>(full_context.begin(), full_context.end());
 	}
 	else
 	{
@@ -59,7 +91,7 @@ pair<bool, double> GramTester::test(const vector<string> &full_context, const st
 		else
 		{
 			// use the most recent words
-			context = vector<string>(full_context.end() - n_gram + 1, full_context.end());
+			context = vector<T>(full_context.end() - n_gram + 1, full_context.end());
 		}
 	}
 
@@ -68,8 +100,3 @@ pair<bool, double> GramTester::test(const vector<string> &full_context, const st
 
 	return score;
 }
-
-GramTester::GramTester(int n_gram, bool q_dfa, MLE mle) :
-	n_gram(n_gram), q_dfa(q_dfa), mle(mle)
-{
-}
@@ -13,14 +13,14 @@ using namespace std;
 
 GramTrainer::Builder::Builder(const string &model_folder, const vector<vector<string>> &sentences, const Config &config) :
 	model_folder(model_folder), sentences(sentences),
-	q_cache(config.get_val<bool>("q_cache", true)), n_thread(config.get_val<int>("n_thread", 4 * thread::hardware_concurrency())),
+	q_cache(config.get_val<bool>("q_cache", true)), q_binary(config.get_val<bool>("q_binary", true)), n_thread(config.get_val<int>("n_thread", 4 * thread::hardware_concurrency())),
 	n_gram(config.get_val<int>("n_gram", get_n_gram())), q_dfa(config.get_val<bool>("q_dfa", true))
 {
 }
 
 unique_ptr<GramTrainer> GramTrainer::Builder::build() const
 {
-	return unique_ptr<GramTrainer>(new GramTrainer(model_folder, sentences, q_cache, unique_ptr<ThreadPool>(new ThreadPool(n_thread)), n_gram, q_dfa));
+	return unique_ptr<GramTrainer>(new GramTrainer(model_folder, sentences, q_cache, q_binary, unique_ptr<ThreadPool>(new ThreadPool(n_thread)), n_gram, q_dfa));
 }
 
 int GramTrainer::Builder::get_n_gram() const
@@ -47,9 +47,9 @@ void GramTrainer::train() const
 	}
 }
 
-GramTrainer::GramTrainer(string model_folder, vector<vector<string>> sentences, bool q_cache, unique_ptr<ThreadPool> thread_pool, int n_gram, bool q_dfa) :
+GramTrainer::GramTrainer(string model_folder, vector<vector<string>> sentences, bool q_cache, bool q_binary, unique_ptr<ThreadPool> thread_pool, int n_gram, bool q_dfa) :
 	model_folder(model_folder), sentences(sentences),
-	thread_pool(move(thread_pool)), q_cache(q_cache),
+	thread_pool(move(thread_pool)), q_cache(q_cache), q_binary(q_binary),
 	n_gram(n_gram), q_dfa(q_dfa)
 {
 	train();
@@ -63,7 +63,7 @@ Gram GramTrainer::get_gram(int n) const
 
 	if (q_cache)
 	{
-		gram = FileIO::get_item_from_file<Gram>(gram_filename);
+		gram = FileIO::get_binary_item_from_file<Gram>(gram_filename);
 		if (!gram.empty())
 		{
 			return gram;
@@ -88,7 +88,7 @@ Gram GramTrainer::get_gram(int n) const
 			}
 		}
 	}
-	FileIO::set_item_to_file<Gram>(gram, gram_filename);
+	FileIO::set_item_to_file<Gram>(gram, gram_filename, q_binary);
 
 	return gram;
 }
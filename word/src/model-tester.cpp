@@ -3,7 +3,9 @@
 #include <algorithm>
 #include <cmath>
 #include <future>
+#include <memory>
 #include <thread>
+#include <utility>
 
 #include "file-io.h"
 #include "hmm.h"
@@ -18,13 +20,34 @@ ModelTester::Builder::Builder(const string &model_folder, const Config &config)
 	model_folder(model_folder), n_thread(config.get_val<int>("n_thread", 4 * thread::hardware_concurrency())),
 	q_trim(config.get_val<bool>("q_trim", true)), x_frame(config.get_val<int>("x_frame", 300)), x_overlap(config.get_val<int>("x_overlap", 80)),
 	cepstral(config.get_val<string>("cepstral", "mfc")), n_cepstra(config.get_val<int>("n_cepstra", 12)),
-	q_gain(config.get_val<bool>("q_gain", false)), q_delta(config.get_val<bool>("q_delta", true)), q_accel(config.get_val<bool>("q_accel", true))
+	q_gain(config.get_val<bool>("q_gain", false)), q_delta(config.get_val<bool>("q_delta", true)), q_accel(config.get_val<bool>("q_accel", true)),
+	n_filters(config.get_val<int>("n_filters", 40)), n_fft(config.get_val<int>("n_fft", 512)),
+	hz_low(config.get_val<double>("hz_low", 50)), hz_high(config.get_val<double>("hz_high", 6500)), hz_sampling(config.get_val<double>("hz_sampling", 16000)),
+	beam(config.get_val<double>("beam", 100.0)), x_active(config.get_val<int>("x_active", 1000)), n_best(config.get_val<int>("n_best", 5)),
+	emission(config.get_val<string>("emission", "discrete")), n_top(config.get_val<int>("n_top", 4))
 {
 }
 
 unique_ptr<ModelTester> ModelTester::Builder::build() const
 {
-	return unique_ptr<ModelTester>(new ModelTester(unique_ptr<ThreadPool>(new ThreadPool(n_thread)), Preprocessor(q_trim, x_frame, x_overlap), get_cepstral(), get_codebook(), get_models()));
+	return build(get_codebook(), get_models());
+}
+
+/// Models with other kinds of emissions can not be tested, the tester is left without models so that every test fails.
+unique_ptr<ModelTester> ModelTester::Builder::build(const Codebook &codebook, const vector<Model> &models) const
+{
+	vector<Model> tested_models = models;
+	for (int i = 0; i < models.size(); ++i)
+	{
+		if (models[i].continuous() != (emission == "gaussian"))
+		{
+			Logger::info("Model does not match the emission:", i, emission);
+			tested_models.clear();
+			break;
+		}
+	}
+
+	return unique_ptr<ModelTester>(new ModelTester(unique_ptr<ThreadPool>(new ThreadPool(n_thread)), Preprocessor(q_trim, x_frame, x_overlap), get_cepstral(), static_cast<int>(hz_sampling), codebook, tested_models, beam, x_active, n_best, emission != "discrete", emission == "semi", n_top));
 }
 
 unique_ptr<ICepstral> ModelTester::Builder::get_cepstral() const
@@ -37,7 +60,8 @@ unique_ptr<ICepstral> ModelTester::Builder::get_cepstral() const
 	}
 	else if (cepstral == "mfc")
 	{
-		icepstal.reset(new MFC(n_cepstra, q_gain, q_delta, q_accel));
+		// frames longer than the fft would be cut
+		icepstal.reset(new MFC(n_cepstra, q_gain, q_delta, q_accel, n_filters, max(n_fft, x_frame), hz_low, hz_high, hz_sampling));
 	}
 
 	return icepstal;
@@ -48,7 +72,7 @@ Codebook ModelTester::Builder::get_codebook() const
 	Logger::log("Loading codebook");
 	const string codebook_filename = model_folder + codebook_ext;
 
-	return FileIO::get_item_from_file<Codebook>(codebook_filename);
+	return FileIO::get_binary_item_from_file<Codebook>(codebook_filename);
 }
 
 vector<Model> ModelTester::Builder::get_models() const
@@ -62,7 +86,7 @@ vector<Model> ModelTester::Builder::get_models() const
 		const string filename = model_folder + to_string(i);
 		const string model_filename = filename + model_ext;
 
-		model = FileIO::get_item_from_file<Model>(model_filename);
+		model = FileIO::get_binary_item_from_file<Model>(model_filename);
 		if (model.empty())
 		{
 			// no more models
@@ -75,28 +99,134 @@ vector<Model> ModelTester::Builder::get_models() const
 	return models;
 }
 
-pair<bool, vector<double>> ModelTester::test(const string &filename) const
+ModelTester::Session::Session(const ModelTester &model_tester) :
+	model_tester(model_tester), preprocessor_stream(model_tester.preprocessor), cepstral_stream(*model_tester.cepstral),
+	n_observations(0), alpha(), new_alpha(), alphas(model_tester.hmms.size()), workspace(), log_Ps(model_tester.hmms.size(), 0.0)
+{
+}
+
+void ModelTester::Session::push(const vector<double> &samples)
+{
+	advance(preprocessor_stream.push(samples), false);
+}
+
+void ModelTester::Session::flush()
+{
+	advance(preprocessor_stream.flush(), true);
+}
+
+pair<bool, vector<double>> ModelTester::Session::scores() const
 {
-	pair<bool, vector<double>> scores(false, vector<double>(models.size(), 0.0));
+	pair<bool, vector<double>> scores(false, vector<double>(log_Ps.size(), 0.0));
 
-	const vector<int> observations = get_observations(filename);
-	if (observations.empty())
+	if (n_observations == 0 || log_Ps.empty())
 	{
 		return scores;
 	}
 
 	scores.first = true;
-	vector<future<pair<double, vector<vector<double>>>>> P_futures;
-	for (int i = 0; i < models.size(); ++i)
+	const double max_log_P = *max_element(log_Ps.begin(), log_Ps.end());
+	for (int i = 0; i < log_Ps.size(); ++i)
 	{
-		P_futures.push_back(thread_pool->enqueue(&HMM::forward, HMM(models[i]), observations));
+		scores.second[i] = exp(log_Ps[i] - max_log_P);
 	}
-	for (int i = 0; i < models.size(); ++i)
+
+	return scores;
+}
+
+vector<int> ModelTester::Session::best(int n_best) const
+{
+	vector<int> indices(log_Ps.size(), 0);
+
+	for (int i = 0; i < indices.size(); ++i)
+	{
+		indices[i] = i;
+	}
+	n_best = min(n_best, (int)indices.size());
+	partial_sort(indices.begin(), indices.begin() + n_best, indices.end(), [this](int a, int b) { return log_Ps[a] > log_Ps[b]; });
+	indices.resize(n_best);
+
+	return indices;
+}
+
+void ModelTester::Session::advance(const vector<vector<double>> &frames, bool q_flush)
+{
+	Features features = cepstral_stream.push(frames);
+	if (q_flush)
+	{
+		features.append(cepstral_stream.flush());
+	}
+	if (features.empty())
+	{
+		return;
+	}
+
+	if (model_tester.q_continuous)
+	{
+		const Densities densities = model_tester.get_densities(features);
+		for (int i = 0; i < model_tester.hmms.size(); ++i)
+		{
+			const pair<vector<double>, Matrix<double>> b = model_tester.get_emissions(i, features, densities);
+			for (int t = 0; t < features.rows(); ++t)
+			{
+				log_Ps[i] += model_tester.hmms[i].forward_step(alphas[i], b.second[t], workspace) + b.first[t];
+			}
+		}
+		n_observations += features.rows();
+		return;
+	}
+
+	const vector<int> observations = model_tester.quantiser.classify(features).second;
+	for (int t = 0; t < observations.size(); ++t)
+	{
+		model_tester.scorer.step(alpha, observations[t], new_alpha, log_Ps);
+		swap(alpha, new_alpha);
+	}
+	n_observations += observations.size();
+}
+
+pair<bool, vector<double>> ModelTester::test(const string &filename) const
+{
+	pair<bool, vector<double>> scores(false, vector<double>(hmms.size(), 0.0));
+
+	if (hmms.empty())
+	{
+		return scores;
+	}
+
+	if (q_continuous)
 	{
-		scores.second[i] = P_futures[i].get().first;
+		const Features features = get_features(filename);
+		if (features.empty())
+		{
+			return scores;
+		}
+
+		scores.first = true;
+		const Densities densities = get_densities(features);
+		vector<future<double>> score_futures;
+		for (int i = 0; i < hmms.size(); ++i)
+		{
+			score_futures.push_back(thread_pool->enqueue(&ModelTester::get_score, this, i, cref(features), cref(densities)));
+		}
+		for (int i = 0; i < hmms.size(); ++i)
+		{
+			scores.second[i] = score_futures[i].get();
+		}
+	}
+	else
+	{
+		const vector<int> observations = get_observations(filename);
+		if (observations.empty())
+		{
+			return scores;
+		}
+
+		scores.first = true;
+		scores.second = scorer.score(observations, thread_pool.get());
 	}
 	const double max_score = *max_element(scores.second.begin(), scores.second.end());
-	for (int i = 0; i < models.size(); ++i)
+	for (int i = 0; i < hmms.size(); ++i)
 	{
 		// https://stats.stackexchange.com/questions/66616/converting-normalizing-very-small-likelihood-values-to-probability
 		scores.second[i] = exp(scores.second[i] - max_score);
@@ -105,36 +235,149 @@ pair<bool, vector<double>> ModelTester::test(const string &filename) const
 	return scores;
 }
 
-ModelTester::ModelTester(unique_ptr<ThreadPool> thread_pool, Preprocessor preprocessor, unique_ptr<ICepstral> cepstral, Codebook codebook, vector<Model> models) :
+pair<bool, vector<pair<int, double>>> ModelTester::decode(const string &filename) const
+{
+	pair<bool, vector<pair<int, double>>> best(false, vector<pair<int, double>>());
+
+	if (hmms.empty())
+	{
+		return best;
+	}
+
+	if (q_continuous)
+	{
+		const Features features = get_features(filename);
+		if (features.empty())
+		{
+			return best;
+		}
+
+		const vector<Matrix<double>> log_bs = get_log_emissions(features, get_densities(features));
+		best.second = decoder.decode(features.rows(), [&log_bs](int model, int t) { return log_bs[model][t]; });
+	}
+	else
+	{
+		const vector<int> observations = get_observations(filename);
+		if (observations.empty())
+		{
+			return best;
+		}
+
+		best.second = decoder.decode(observations);
+	}
+	best.first = !best.second.empty();
+	for (int i = best.second.size() - 1; i >= 0; --i)
+	{
+		// relative to the best as in test
+		best.second[i].second = exp(best.second[i].second - best.second[0].second);
+	}
+
+	return best;
+}
+
+pair<bool, vector<int>> ModelTester::decode(const string &filename, const Decoder::LanguageScore &language_score, int x_history) const
+{
+	pair<bool, vector<int>> models(false, vector<int>());
+
+	if (hmms.empty())
+	{
+		return models;
+	}
+
+	if (q_continuous)
+	{
+		const Features features = get_features(filename);
+		if (features.empty())
+		{
+			return models;
+		}
+
+		const vector<Matrix<double>> log_bs = get_log_emissions(features, get_densities(features));
+		models.second = decoder.decode(features.rows(), [&log_bs](int model, int t) { return log_bs[model][t]; }, language_score, x_history).second;
+	}
+	else
+	{
+		const vector<int> observations = get_observations(filename);
+		if (observations.empty())
+		{
+			return models;
+		}
+
+		models.second = decoder.decode(observations, language_score, x_history).second;
+	}
+	models.first = !models.second.empty();
+
+	return models;
+}
+
+ModelTester::ModelTester(unique_ptr<ThreadPool> thread_pool, Preprocessor preprocessor, unique_ptr<ICepstral> cepstral, int hz_sampling, Codebook codebook, vector<Model> models, double beam, int x_active, int n_best, bool q_continuous, bool q_semi, int n_top) :
 	thread_pool(move(thread_pool)),
-	preprocessor(preprocessor), cepstral(move(cepstral)), codebook(codebook), models(models)
+	preprocessor(preprocessor), cepstral(move(cepstral)), hz_sampling(hz_sampling), quantiser(codebook.quantiser()), gmm(q_semi ? codebook.gmm() : GMM()), hmms(models.begin(), models.end()),
+	q_continuous(q_continuous), q_semi(q_semi), n_top(n_top), scorer(q_continuous ? vector<Model>() : models), decoder(hmms, beam, x_active, n_best)
 {
 }
 
+/// Densities are found once for the features and shared by all models.
+Densities ModelTester::get_densities(const Features &features) const
+{
+	return q_semi ? gmm.top(features, n_top) : Densities();
+}
+
+pair<vector<double>, Matrix<double>> ModelTester::get_emissions(int model_index, const Features &features, const Densities &densities) const
+{
+	return q_semi ? hmms[model_index].emissions(densities) : hmms[model_index].emissions(features);
+}
+
+double ModelTester::get_score(int model_index, const Features &features, const Densities &densities) const
+{
+	vector<double> workspace;
+
+	return q_semi ? hmms[model_index].score(densities, workspace) : hmms[model_index].score(features, workspace);
+}
+
+/// Log emissions of all models are found before decoding, in parallel.
+vector<Matrix<double>> ModelTester::get_log_emissions(const Features &features, const Densities &densities) const
+{
+	vector<Matrix<double>> log_bs;
+
+	vector<future<Matrix<double>>> log_b_futures;
+	for (int i = 0; i < hmms.size(); ++i)
+	{
+		log_b_futures.push_back(thread_pool->enqueue([this, &features, &densities](int model_index) { return q_semi ? hmms[model_index].log_emissions(densities) : hmms[model_index].log_emissions(features); }, i));
+	}
+	for (int i = 0; i < hmms.size(); ++i)
+	{
+		log_bs.push_back(log_b_futures[i].get());
+	}
+
+	return log_bs;
+}
+
 vector<int> ModelTester::get_observations(const string &filename) const
 {
 	vector<int> observations;
 	Logger::log("Getting observations");
 
-	const vector<Feature> features = get_features(filename);
+	const Features features = get_features(filename);
 	if (features.empty())
 	{
 		return observations;
 	}
 
-	observations = codebook.observations(features);
+	observations = quantiser.classify(features).second;
 
 	return observations;
 }
 
-vector<Feature> ModelTester::get_features(const string &filename) const
+Features ModelTester::get_features(const string &filename) const
 {
-	vector<Feature> features;
+	Features features;
 	Logger::log("Getting features");
 
 	const string wav_filename = filename + wav_ext;
-	const Wav wav_file = FileIO::get_item_from_file<Wav>(wav_filename);
-	const vector<double> samples = wav_file.samples<double>();
+	const pair<shared_ptr<const char>, size_t> mapping = FileIO::map_file(wav_filename);
+	const Wav wav_file(mapping.first, mapping.second);
+	const vector<double> samples = wav_file.resample(hz_sampling);
 	if (samples.empty())
 	{
 		// wav file not found
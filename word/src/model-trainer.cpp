@@ -1,6 +1,9 @@
 #include "model-trainer.h"
 
+#include <algorithm>
+#include <functional>
 #include <future>
+#include <memory>
 #include <thread>
 #include <utility>
 
@@ -15,18 +18,23 @@ using namespace std;
 
 ModelTrainer::Builder::Builder(const string &train_folder, const string &model_folder, const vector<string> &words, const Config &config) :
 	train_folder(train_folder), model_folder(model_folder), words(words),
-	q_cache(config.get_val<bool>("q_cache", true)), n_thread(config.get_val<int>("n_thread", 4 * thread::hardware_concurrency())),
+	q_cache(config.get_val<bool>("q_cache", true)), q_binary(config.get_val<bool>("q_binary", true)), n_thread(config.get_val<int>("n_thread", 4 * thread::hardware_concurrency())),
 	q_trim(config.get_val<bool>("q_trim", true)), x_frame(config.get_val<int>("x_frame", 300)), x_overlap(config.get_val<int>("x_overlap", 80)),
 	cepstral(config.get_val<string>("cepstral", "mfc")), n_cepstra(config.get_val<int>("n_cepstra", 12)),
 	q_gain(config.get_val<bool>("q_gain", false)), q_delta(config.get_val<bool>("q_delta", true)), q_accel(config.get_val<bool>("q_accel", true)),
-	x_codebook(config.get_val<int>("x_codebook", 128)),
-	n_state(config.get_val<int>("n_state", 15)), n_bakis(config.get_val<int>("n_bakis", 3)), n_retrain(config.get_val<int>("n_retrain", 3))
+	n_filters(config.get_val<int>("n_filters", 40)), n_fft(config.get_val<int>("n_fft", 512)),
+	hz_low(config.get_val<double>("hz_low", 50)), hz_high(config.get_val<double>("hz_high", 6500)), hz_sampling(config.get_val<double>("hz_sampling", 16000)),
+	x_codebook(config.get_val<int>("x_codebook", 128)), q_hamerly(config.get_val<bool>("q_hamerly", false)),
+	x_batch(config.get_val<int>("x_batch", 0)), p_sample(config.get_val<double>("p_sample", 1.0)),
+	n_state(config.get_val<int>("n_state", 15)), n_bakis(config.get_val<int>("n_bakis", 3)), q_band(config.get_val<bool>("q_band", false)),
+	emission(config.get_val<string>("emission", "discrete")), n_mixture(config.get_val<int>("n_mixture", 2)),
+	n_top(config.get_val<int>("n_top", 4))
 {
 }
 
 unique_ptr<ModelTrainer> ModelTrainer::Builder::build() const
 {
-	return unique_ptr<ModelTrainer>(new ModelTrainer(train_folder, model_folder, words, q_cache, unique_ptr<ThreadPool>(new ThreadPool(n_thread)), Preprocessor(q_trim, x_frame, x_overlap), get_cepstral(), LBG(x_codebook), Model::Builder(n_state, x_codebook, n_bakis), n_retrain));
+	return unique_ptr<ModelTrainer>(new ModelTrainer(train_folder, model_folder, words, q_cache, q_binary, unique_ptr<ThreadPool>(new ThreadPool(n_thread)), Preprocessor(q_trim, x_frame, x_overlap), get_cepstral(), static_cast<int>(hz_sampling), LBG(x_codebook, q_hamerly, x_batch, p_sample), Model::Builder(n_state, emission == "gaussian" ? n_mixture : x_codebook, n_bakis), x_batch > 0, q_band, emission == "gaussian", emission == "semi", n_top));
 }
 
 unique_ptr<ICepstral> ModelTrainer::Builder::get_cepstral() const
@@ -39,31 +47,66 @@ unique_ptr<ICepstral> ModelTrainer::Builder::get_cepstral() const
 	}
 	else if (cepstral == "mfc")
 	{
-		icepstal.reset(new MFC(n_cepstra, q_gain, q_delta, q_accel));
+		// frames longer than the fft would be cut
+		icepstal.reset(new MFC(n_cepstra, q_gain, q_delta, q_accel, n_filters, max(n_fft, x_frame), hz_low, hz_high, hz_sampling));
 	}
 
 	return icepstal;
 }
 
+/// Observations of all words are found in parallel, then each word is optimised with its utterances in parallel.
+/// Continuous models are optimised over the features, so no codebook is needed.
 void ModelTrainer::train() const
 {
+	if (q_continuous)
+	{
+		vector<future<vector<Features>>> features_futures;
+		for (int i = 0; i < words.size(); ++i)
+		{
+			features_futures.push_back(thread_pool->enqueue(&ModelTrainer::get_word_features, this, i));
+		}
+		for (int i = 0; i < words.size(); ++i)
+		{
+			get_word_model(i, features_futures[i].get());
+		}
+
+		return;
+	}
+
 	const Codebook codebook = get_codebook();
 
-	vector<future<Model>> model_futures;
+	if (q_semi)
+	{
+		const GMM gmm = codebook.gmm();
+		vector<future<vector<Densities>>> densities_futures;
+		for (int i = 0; i < words.size(); ++i)
+		{
+			densities_futures.push_back(thread_pool->enqueue(&ModelTrainer::get_word_densities, this, i, cref(gmm)));
+		}
+		for (int i = 0; i < words.size(); ++i)
+		{
+			get_word_model(i, densities_futures[i].get());
+		}
+
+		return;
+	}
+
+	const Quantiser quantiser = codebook.quantiser();
+	vector<future<vector<vector<int>>>> observations_futures;
 	for (int i = 0; i < words.size(); ++i)
 	{
-		model_futures.push_back(thread_pool->enqueue(&ModelTrainer::get_word_model, this, i, codebook));
+		observations_futures.push_back(thread_pool->enqueue(&ModelTrainer::get_word_observations, this, i, cref(quantiser)));
 	}
 	for (int i = 0; i < words.size(); ++i)
 	{
-		model_futures[i].get();
+		get_word_model(i, observations_futures[i].get());
 	}
 }
 
-ModelTrainer::ModelTrainer(string train_folder, string model_folder, vector<string> words, bool q_cache, unique_ptr<ThreadPool> thread_pool, Preprocessor preprocessor, unique_ptr<ICepstral> cepstral, LBG lbg, Model::Builder model_builder, int n_retrain) :
+ModelTrainer::ModelTrainer(string train_folder, string model_folder, vector<string> words, bool q_cache, bool q_binary, unique_ptr<ThreadPool> thread_pool, Preprocessor preprocessor, unique_ptr<ICepstral> cepstral, int hz_sampling, LBG lbg, Model::Builder model_builder, bool q_stream, bool q_band, bool q_continuous, bool q_semi, int n_top) :
 	train_folder(train_folder), model_folder(model_folder), words(words),
-	q_cache(q_cache), thread_pool(move(thread_pool)),
-	preprocessor(preprocessor), cepstral(move(cepstral)), lbg(lbg), model_builder(model_builder), n_retrain(n_retrain)
+	q_cache(q_cache), q_binary(q_binary), thread_pool(move(thread_pool)),
+	preprocessor(preprocessor), cepstral(move(cepstral)), hz_sampling(hz_sampling), lbg(lbg), model_builder(model_builder), q_stream(q_stream), q_band(q_band), q_continuous(q_continuous), q_semi(q_semi), n_top(n_top)
 {
 	train();
 }
@@ -76,87 +119,142 @@ Codebook ModelTrainer::get_codebook() const
 
 	if (q_cache)
 	{
-		codebook = FileIO::get_item_from_file<Codebook>(codebook_filename);
-		if (!codebook.empty())
+		codebook = FileIO::get_binary_item_from_file<Codebook>(codebook_filename);
+		// semi continuous models need the variances of the buckets as well
+		if (!codebook.empty() && (!q_semi || !codebook.variances.empty()))
 		{
 			return codebook;
 		}
 	}
 
-	const vector<Feature> universe = get_universe();
-	codebook = lbg.generate(universe);
-	FileIO::set_item_to_file<Codebook>(codebook, codebook_filename);
+	if (q_stream)
+	{
+		// the universe is never held in memory, features are read back from their caches in batches
+		vector<string> features_filenames;
+		vector<future<vector<string>>> filenames_futures;
+		for (int i = 0; i < words.size(); ++i)
+		{
+			filenames_futures.push_back(thread_pool->enqueue(&ModelTrainer::get_word_features_filenames, this, i));
+		}
+		for (int i = 0; i < words.size(); ++i)
+		{
+			const vector<string> word_features_filenames = filenames_futures[i].get();
+			features_filenames.insert(features_filenames.end(), word_features_filenames.begin(), word_features_filenames.end());
+		}
+
+		const function<Features(int)> source = [&features_filenames](int i) { return FileIO::get_binary_item_from_file<Features>(features_filenames[i]); };
+		codebook = lbg.generate(source, features_filenames.size());
+	}
+	else
+	{
+		const Features universe = get_universe();
+		codebook = lbg.generate(universe, thread_pool.get());
+	}
+	FileIO::set_item_to_file<Codebook>(codebook, codebook_filename, q_binary);
 
 	return codebook;
 }
 
-vector<Feature> ModelTrainer::get_universe() const
+Features ModelTrainer::get_universe() const
 {
 	Logger::log("Getting universe");
-	vector<Feature> universe;
+	Features universe;
 	const string universe_filename = model_folder + universe_ext;
 
 	if (q_cache)
 	{
-		universe = FileIO::get_vector_from_file<Feature>(universe_filename, '\n');
+		universe = FileIO::get_binary_item_from_file<Features>(universe_filename);
 		if (!universe.empty())
 		{
 			return universe;
 		}
 	}
 
-	vector<future<vector<Feature>>> word_universe_futures;
+	vector<future<Features>> word_universe_futures;
 	for (int i = 0; i < words.size(); ++i)
 	{
 		word_universe_futures.push_back(thread_pool->enqueue(&ModelTrainer::get_word_universe, this, i));
 	}
 	for (int i = 0; i < words.size(); ++i)
 	{
-		const vector<Feature> word_universe = word_universe_futures[i].get();
-		universe.insert(universe.end(), word_universe.begin(), word_universe.end());
+		universe.append(word_universe_futures[i].get());
 	}
 
-	FileIO::set_vector_to_file<Feature>(universe, universe_filename, '\n');
+	FileIO::set_item_to_file<Features>(universe, universe_filename, q_binary);
 
 	return universe;
 }
 
-vector<Feature> ModelTrainer::get_word_universe(int word_index) const
+Features ModelTrainer::get_word_universe(int word_index) const
 {
-	vector<Feature> word_universe;
+	Features word_universe;
 
 	for (int i = 0; ; ++i)
 	{
-		const vector<Feature> features = get_features(i, word_index);
+		const Features features = get_features(i, word_index);
 		if (features.empty())
 		{
 			break;
 		}
 
-		word_universe.insert(word_universe.end(), features.begin(), features.end());
+		word_universe.append(features);
 	}
 
 	return word_universe;
 }
 
-vector<Feature> ModelTrainer::get_features(int utterance_index, int word_index) const
+vector<string> ModelTrainer::get_word_features_filenames(int word_index) const
+{
+	vector<string> features_filenames;
+
+	for (int i = 0; ; ++i)
+	{
+		if (!FileIO::exists(get_wav_filename(i, word_index)))
+		{
+			// no more utterances
+			break;
+		}
+
+		// cached features are not read again, they are read in batches later
+		const string features_filename = get_features_filename(i, word_index);
+		if ((q_cache && FileIO::exists(features_filename)) || !get_features(i, word_index).empty())
+		{
+			features_filenames.push_back(features_filename);
+		}
+	}
+
+	return features_filenames;
+}
+
+string ModelTrainer::get_wav_filename(int utterance_index, int word_index) const
+{
+	return train_folder + words[word_index] + '_' + to_string(utterance_index) + wav_ext;
+}
+
+string ModelTrainer::get_features_filename(int utterance_index, int word_index) const
+{
+	return model_folder + words[word_index] + '_' + to_string(utterance_index) + features_ext;
+}
+
+Features ModelTrainer::get_features(int utterance_index, int word_index) const
 {
 	Logger::log("Getting features:", word_index, utterance_index);
-	vector<Feature> features;
-	const string features_filename = model_folder + words[word_index] + '_' + to_string(utterance_index) + features_ext;
+	Features features;
+	const string features_filename = get_features_filename(utterance_index, word_index);
 
 	if (q_cache)
 	{
-		features = FileIO::get_vector_from_file<Feature>(features_filename);
+		features = FileIO::get_binary_item_from_file<Features>(features_filename);
 		if (!features.empty())
 		{
 			return features;
 		}
 	}
 
-	const string wav_filename = train_folder + words[word_index] + '_' + to_string(utterance_index) + wav_ext;
-	const Wav wav_file = FileIO::get_item_from_file<Wav>(wav_filename);
-	const vector<double> samples = wav_file.samples<double>();
+	const string wav_filename = get_wav_filename(utterance_index, word_index);
+	const pair<shared_ptr<const char>, size_t> mapping = FileIO::map_file(wav_filename);
+	const Wav wav_file(mapping.first, mapping.second);
+	const vector<double> samples = wav_file.resample(hz_sampling);
 	if (samples.empty())
 	{
 		// file not found
@@ -165,12 +263,27 @@ vector<Feature> ModelTrainer::get_features(int utterance_index, int word_index)
 
 	const vector<vector<double>> frames = preprocessor.process(samples);
 	features = cepstral->features(frames);
-	FileIO::set_vector_to_file<Feature>(features, features_filename);
+	FileIO::set_item_to_file<Features>(features, features_filename, q_binary);
 
 	return features;
 }
 
-Model ModelTrainer::get_word_model(int word_index, const Codebook &codebook) const
+Model ModelTrainer::get_word_model(int word_index, const vector<vector<int>> &observations) const
+{
+	return get_word_model(word_index, [this, &observations]() { return HMM(model_builder.bakis(), q_band).optimise(observations, thread_pool.get()); });
+}
+
+Model ModelTrainer::get_word_model(int word_index, const vector<Features> &features) const
+{
+	return get_word_model(word_index, [this, &features]() { return HMM(model_builder.bakis(features), q_band).optimise(features, thread_pool.get()); });
+}
+
+Model ModelTrainer::get_word_model(int word_index, const vector<Densities> &densities) const
+{
+	return get_word_model(word_index, [this, &densities]() { return HMM(model_builder.bakis(), q_band).optimise(densities, thread_pool.get()); });
+}
+
+Model ModelTrainer::get_word_model(int word_index, const function<Model()> &optimise) const
 {
 	Logger::log("Getting model:", word_index);
 	Model model;
@@ -178,63 +291,83 @@ Model ModelTrainer::get_word_model(int word_index, const Codebook &codebook) con
 
 	if (q_cache)
 	{
-		model = FileIO::get_item_from_file<Model>(model_filename);
-		if (!model.empty())
+		model = FileIO::get_binary_item_from_file<Model>(model_filename);
+		// models cached with another kind of emissions are trained again
+		if (!model.empty() && model.continuous() == q_continuous)
 		{
 			return model;
 		}
 	}
 
-	model = model_builder.bakis();
-	for (int j = 0; j < n_retrain; ++j)
+	model = optimise();
+	FileIO::set_item_to_file<Model>(model, model_filename, q_binary);
+
+	return model;
+}
+
+vector<Features> ModelTrainer::get_word_features(int word_index) const
+{
+	vector<Features> word_features;
+
+	for (int i = 0; ; ++i)
 	{
-		Logger::log("Getting train model:", word_index, j);
-		Model train_model;
-		const string train_model_filename = model_folder + words[word_index] + model_ext + "_" + to_string(j);
+		const Features features = get_features(i, word_index);
+		if (features.empty())
+		{
+			// no more utterances
+			break;
+		}
 
-		if (q_cache)
+		word_features.push_back(features);
+	}
+
+	return word_features;
+}
+
+/// Densities are not cached, they depend on n_top as well as the codebook.
+vector<Densities> ModelTrainer::get_word_densities(int word_index, const GMM &gmm) const
+{
+	vector<Densities> word_densities;
+
+	for (int i = 0; ; ++i)
+	{
+		const Features features = get_features(i, word_index);
+		if (features.empty())
 		{
-			train_model = FileIO::get_item_from_file<Model>(train_model_filename);
-			if (!train_model.empty())
-			{
-				model = train_model;
-				continue;
-			}
+			// no more utterances
+			break;
 		}
 
-		train_model = get_utterance_model(word_index, model, codebook);
-		FileIO::set_item_to_file<Model>(train_model, train_model_filename);
-		model = train_model;
+		word_densities.push_back(gmm.top(features, n_top));
 	}
-	FileIO::set_item_to_file<Model>(model, model_filename);
 
-	return model;
+	return word_densities;
 }
 
-Model ModelTrainer::get_utterance_model(int word_index, const Model &train_model, const Codebook &codebook) const
+vector<vector<int>> ModelTrainer::get_word_observations(int word_index, const Quantiser &quantiser) const
 {
-	vector<Model> utterance_models;
+	vector<vector<int>> word_observations;
 
 	for (int i = 0; ; ++i)
 	{
-		const vector<int> observations = get_observations(i, word_index, codebook);
+		const vector<int> observations = get_observations(i, word_index, quantiser);
 		if (observations.empty())
 		{
 			// no more utterances
 			break;
 		}
 
-		utterance_models.push_back(HMM(train_model).optimise(observations));
+		word_observations.push_back(observations);
 	}
 
-	return model_builder.merge(utterance_models);
+	return word_observations;
 }
 
-vector<int> ModelTrainer::get_observations(int utterance_index, int word_index, const Codebook &codebook) const
+vector<int> ModelTrainer::get_observations(int utterance_index, int word_index, const Quantiser &quantiser) const
 {
 	Logger::log("Getting observations:", word_index, utterance_index);
 	vector<int> observations;
-	const string obs_filename =  + observations_ext;
+	const string obs_filename = model_folder + words[word_index] + '_' + to_string(utterance_index) + observations_ext;
 
 	if (q_cache)
 	{
@@ -245,13 +378,13 @@ vector<int> ModelTrainer::get_observations(int utterance_index, int word_index,
 		}
 	}
 
-	const vector<Feature> features = get_features(utterance_index, word_index);
+	const Features features = get_features(utterance_index, word_index);
 	if (features.empty())
 	{
 		return observations;
 	}
 
-	observations = codebook.observations(features);
+	observations = quantiser.classify(features).second;
 	FileIO::set_vector_to_file<int>(observations, obs_filename);
 
 	return observations;
@@ -1,20 +1,43 @@
 #include "recogniser.h"
 
 #include <algorithm>
+#include <cmath>
 #include <limits>
+
+#include "file-io.h"
 #include "logger.h"
 
 using namespace std;
 
 Recogniser::Builder::Builder(const string &model_folder, const vector<string> &words, const vector<vector<string>> &sentences, const Config &config) :
-	model_folder(model_folder), words(words), sentences(sentences), config(config),
-	gram_weight(config.get_val<double>("gram_weight", 0.5)), cutoff_score(config.get_val<double>("cutoff_score", 0.5))
+	q_bundle(false), bundle(), model_folder(model_folder), words(words), sentences(sentences), config(config),
+	gram_weight(config.get_val<double>("gram_weight", 0.5)), gram_scale(config.get_val<double>("gram_scale", 1.0)), cutoff_score(config.get_val<double>("cutoff_score", 0.5))
+{
+}
+
+Recogniser::Builder::Builder(const string &bundle_filename) :
+	Builder(FileIO::get_mapped_item_from_file<Bundle>(bundle_filename))
 {
+	if (bundle.empty())
+	{
+		Logger::info("Bundle could not be read:", bundle_filename);
+	}
 }
 
 unique_ptr<Recogniser> Recogniser::Builder::build() const
 {
-	return unique_ptr<Recogniser>(new Recogniser(words, sentences, ModelTester::Builder(model_folder, config).build(), GramTester::Builder(model_folder, config).build(), gram_weight, cutoff_score));
+	if (q_bundle)
+	{
+		if (bundle.empty())
+		{
+			return unique_ptr<Recogniser>();
+		}
+
+		return unique_ptr<Recogniser>(new Recogniser(words, sentences, ModelTester::Builder(model_folder, config).build(bundle.codebook, bundle.models), GramTester::Builder(model_folder, config).build(bundle.grams, words), gram_weight, gram_scale, cutoff_score));
+	}
+
+	const GramTester::Builder gram_tester_builder(model_folder, config);
+	return unique_ptr<Recogniser>(new Recogniser(words, sentences, ModelTester::Builder(model_folder, config).build(), gram_tester_builder.build(gram_tester_builder.get_grams(), words), gram_weight, gram_scale, cutoff_score));
 }
 
 pair<bool, string> Recogniser::recognise(const string &filename)
@@ -28,10 +51,10 @@ pair<bool, string> Recogniser::recognise(const string &filename)
 	}
 
 	double best_mixed_score = numeric_limits<double>::min();
-	string best_word;
+	int best_index = -1;
 	for (int i = 0; i < words.size(); ++i)
 	{
-		const pair<bool, double> gram_score = gram_tester->test(context, words[i]);
+		const pair<bool, double> gram_score = gram_tester->test(context, i);
 		if (!gram_score.first || gram_score.second == 0.0)
 		{
 			continue;
@@ -41,28 +64,71 @@ pair<bool, string> Recogniser::recognise(const string &filename)
 		if (best_mixed_score < mixed_score)
 		{
 			best_mixed_score = mixed_score;
-			best_word = words[i];
+			best_index = i;
 		}
 	}
-	word.first = !best_word.empty() && best_mixed_score >= cutoff_score;
-	word.second = best_word;
+	word.first = best_index >= 0 && best_mixed_score >= cutoff_score;
+	word.second = best_index >= 0 ? words[best_index] : string();
 
 	if (word.first)
 	{
 		// add good word to context
-		context.push_back(word.second);
+		context.push_back(best_index);
 	}
 
 	return word;
 }
 
+/// Gram scores are applied in log domain at every word boundary inside the search.
+/// Only the latest words of the context can change a gram score, so the rest of it is not looked at.
+pair<bool, vector<string>> Recogniser::recognise_sentence(const string &filename)
+{
+	pair<bool, vector<string>> sentence(false, vector<string>());
+
+	const int x_context = gram_tester->x_context();
+	const vector<int> latest_context(context.end() - min(x_context, static_cast<int>(context.size())), context.end());
+	const Decoder::LanguageScore language_score = [this, &latest_context](const vector<int> &history, int model)
+	{
+		vector<int> full_context = latest_context;
+		full_context.insert(full_context.end(), history.begin(), history.end());
+		const pair<bool, double> gram_score = gram_tester->test(full_context, model);
+		if (!gram_score.first || gram_score.second == 0.0)
+		{
+			return -numeric_limits<double>::infinity();
+		}
+
+		return gram_scale * log(gram_score.second);
+	};
+	const pair<bool, vector<int>> models = model_tester->decode(filename, language_score, x_context);
+	if (!models.first)
+	{
+		return sentence;
+	}
+
+	sentence.first = true;
+	for (int i = 0; i < models.second.size(); ++i)
+	{
+		sentence.second.push_back(words[models.second[i]]);
+	}
+	// add the sentence to context
+	context.insert(context.end(), models.second.begin(), models.second.end());
+
+	return sentence;
+}
+
 void Recogniser::reset()
 {
 	context.clear();
 }
 
-Recogniser::Recogniser(vector<string> words, vector<vector<string>> sentences, unique_ptr<ModelTester> model_tester, unique_ptr<GramTester> gram_tester, double gram_weight, double cutoff_score) :
+Recogniser::Builder::Builder(const Bundle &bundle) :
+	q_bundle(true), bundle(bundle), model_folder(), words(bundle.words), sentences(), config(bundle.config),
+	gram_weight(config.get_val<double>("gram_weight", 0.5)), gram_scale(config.get_val<double>("gram_scale", 1.0)), cutoff_score(config.get_val<double>("cutoff_score", 0.5))
+{
+}
+
+Recogniser::Recogniser(vector<string> words, vector<vector<string>> sentences, unique_ptr<ModelTester> model_tester, unique_ptr<GramTester> gram_tester, double gram_weight, double gram_scale, double cutoff_score) :
 	words(words), sentences(sentences),
-	model_tester(move(model_tester)), gram_tester(move(gram_tester)), gram_weight(gram_weight), cutoff_score(cutoff_score), context()
+	model_tester(move(model_tester)), gram_tester(move(gram_tester)), gram_weight(gram_weight), gram_scale(gram_scale), cutoff_score(cutoff_score), context()
 {
 }
@@ -0,0 +1,288 @@
+#include "wav.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <string>
+
+#include "cpu.h"
+#include "resampler.h"
+
+using namespace std;
+
+Wav::Wav() :
+	values(), n_frames(0), n_channels(0), hz_sampling(0), x_sample(0), q_float(false)
+{
+}
+
+Wav::Wav(shared_ptr<const char> data, size_t size) :
+	Wav()
+{
+	if (!setup(data, size))
+	{
+		*this = Wav();
+	}
+}
+
+bool Wav::valid() const
+{
+	return values != nullptr;
+}
+
+int Wav::rate() const
+{
+	return hz_sampling;
+}
+
+int Wav::channels() const
+{
+	return n_channels;
+}
+
+int Wav::size() const
+{
+	return n_frames;
+}
+
+const int16_t *Wav::data() const
+{
+	return x_sample == sizeof(int16_t) ? reinterpret_cast<const int16_t *>(values.get()) : nullptr;
+}
+
+void Wav::samples(double *buffer) const
+{
+	static const DoubleKernel kernel = CPU::avx2() ? static_cast<DoubleKernel>(&Wav::avx2_kernel) : static_cast<DoubleKernel>(&Wav::scalar_kernel);
+
+	convert(0, n_frames, buffer, kernel);
+}
+
+void Wav::samples(float *buffer) const
+{
+	static const FloatKernel kernel = CPU::avx2() ? static_cast<FloatKernel>(&Wav::avx2_kernel) : static_cast<FloatKernel>(&Wav::scalar_kernel);
+
+	convert(0, n_frames, buffer, kernel);
+}
+
+/// Only a block of samples at the rate of the file is held at a time.
+vector<double> Wav::resample(int hz_output) const
+{
+	if (hz_output == hz_sampling || !valid())
+	{
+		return samples<double>();
+	}
+
+	static const DoubleKernel kernel = CPU::avx2() ? static_cast<DoubleKernel>(&Wav::avx2_kernel) : static_cast<DoubleKernel>(&Wav::scalar_kernel);
+	vector<double> resampled_samples;
+	resampled_samples.reserve(static_cast<size_t>(static_cast<double>(n_frames) * hz_output / hz_sampling) + 1);
+
+	Resampler resampler(hz_sampling, hz_output);
+	vector<double> block;
+	for (int i = 0; i < n_frames; i += x_block)
+	{
+		block.resize(min(x_block, n_frames - i));
+		convert(i, i + block.size(), block.data(), kernel);
+		const vector<double> resampled = resampler.push(block);
+		resampled_samples.insert(resampled_samples.end(), resampled.begin(), resampled.end());
+	}
+	const vector<double> resampled = resampler.flush();
+	resampled_samples.insert(resampled_samples.end(), resampled.begin(), resampled.end());
+
+	return resampled_samples;
+}
+
+/// The stream is copied once so that it can be walked like a mapped file.
+istream &operator>>(istream &input, Wav &wav)
+{
+	wav = Wav();
+	if (!input.good())
+	{
+		return input;
+	}
+
+	const string chars{ istreambuf_iterator<char>(input), istreambuf_iterator<char>() };
+	const shared_ptr<char> data(new char[chars.size()], default_delete<char[]>());
+	memcpy(data.get(), chars.data(), chars.size());
+	if (!wav.setup(data, chars.size()))
+	{
+		wav = Wav();
+		input.setstate(ios::failbit);
+	}
+
+	return input;
+}
+
+/// Chunks are padded to an even size, a truncated data chunk keeps the frames which are there.
+bool Wav::setup(const shared_ptr<const char> &data, size_t size)
+{
+	if (data == nullptr || size < 12 || memcmp(data.get(), "RIFF", 4) != 0 || memcmp(data.get() + 8, "WAVE", 4) != 0)
+	{
+		return false;
+	}
+
+	bool q_format = false;
+	for (size_t offset = 12; offset + 8 <= size;)
+	{
+		const char *chunk = data.get() + offset;
+		const size_t x_chunk = get_value<uint32_t>(chunk + 4);
+		if (memcmp(chunk, "fmt ", 4) == 0)
+		{
+			if (x_chunk < 16 || offset + 8 + x_chunk > size)
+			{
+				return false;
+			}
+
+			// extensible formats keep the actual format at the start of their sub format
+			const uint16_t audio_format = get_value<uint16_t>(chunk + 8);
+			const uint16_t format = audio_format == extensible_format && x_chunk >= 40 ? get_value<uint16_t>(chunk + 32) : audio_format;
+			n_channels = get_value<uint16_t>(chunk + 10);
+			hz_sampling = get_value<uint32_t>(chunk + 12);
+			const uint16_t block_align = get_value<uint16_t>(chunk + 20), bits_per_sample = get_value<uint16_t>(chunk + 22);
+			x_sample = bits_per_sample / 8;
+			q_float = format == float_format;
+			const bool q_pcm = format == pcm_format && bits_per_sample % 8 == 0 && x_sample >= 1 && x_sample <= 4;
+			if (!(q_pcm || (q_float && bits_per_sample == 32)) || n_channels == 0 || hz_sampling <= 0 || block_align != n_channels * x_sample)
+			{
+				return false;
+			}
+			q_format = true;
+		}
+		else if (memcmp(chunk, "data", 4) == 0)
+		{
+			if (!q_format)
+			{
+				return false;
+			}
+
+			const size_t x_frame = n_channels * x_sample;
+			n_frames = static_cast<int>(min(x_chunk, size - offset - 8) / x_frame);
+			values = shared_ptr<const char>(data, chunk + 8);
+			if (reinterpret_cast<uintptr_t>(values.get()) % alignof(int16_t) != 0)
+			{
+				// samples need to be aligned to be viewed
+				const shared_ptr<char> copy(new char[n_frames * x_frame], default_delete<char[]>());
+				memcpy(copy.get(), chunk + 8, n_frames * x_frame);
+				values = copy;
+			}
+
+			return n_frames > 0;
+		}
+		offset += 8 + x_chunk + (x_chunk & 1);
+	}
+
+	return false;
+}
+
+/// Channels are averaged, mono 16 bit samples are converted by the kernel.
+template <typename T, typename Kernel>
+void Wav::convert(int begin, int end, T *buffer, Kernel kernel) const
+{
+	if (n_channels == 1 && x_sample == sizeof(int16_t))
+	{
+		kernel(data() + begin, end - begin, buffer);
+		return;
+	}
+
+	const int x_frame = n_channels * x_sample;
+	for (int i = begin; i < end; ++i)
+	{
+		const char *frame = values.get() + static_cast<size_t>(i) * x_frame;
+		double sample = 0.0;
+		for (int c = 0; c < n_channels; ++c)
+		{
+			sample += get_sample(frame + c * x_sample);
+		}
+		buffer[i - begin] = static_cast<T>(sample / n_channels);
+	}
+}
+
+double Wav::get_sample(const char *bytes) const
+{
+	switch (x_sample)
+	{
+	case 1:
+		// 8 bit samples are unsigned
+		return (static_cast<unsigned char>(bytes[0]) - 128) * 256.0;
+	case 2:
+		return static_cast<int16_t>(get_value<uint16_t>(bytes));
+	case 3:
+		// shifted up so that the sign is kept
+		return static_cast<int32_t>((get_value<uint16_t>(bytes) | static_cast<uint32_t>(static_cast<unsigned char>(bytes[2])) << 16) << 8) / 65536.0;
+	default:
+		if (q_float)
+		{
+			const uint32_t bits = get_value<uint32_t>(bytes);
+			float sample;
+			memcpy(&sample, &bits, sizeof(float));
+
+			return sample * 32768.0;
+		}
+
+		return static_cast<int32_t>(get_value<uint32_t>(bytes)) / 65536.0;
+	}
+}
+
+template <typename T>
+T Wav::get_value(const char *bytes)
+{
+	T value = 0;
+
+	for (int i = sizeof(T) - 1; i >= 0; --i)
+	{
+		value = static_cast<T>((value << 8) | static_cast<unsigned char>(bytes[i]));
+	}
+
+	return value;
+}
+
+void Wav::scalar_kernel(const int16_t *pcm, int n_samples, double *values)
+{
+	for (int i = 0; i < n_samples; ++i)
+	{
+		values[i] = pcm[i];
+	}
+}
+
+void Wav::scalar_kernel(const int16_t *pcm, int n_samples, float *values)
+{
+	for (int i = 0; i < n_samples; ++i)
+	{
+		values[i] = pcm[i];
+	}
+}
+
+#ifdef SR_LIB_X86
+SR_LIB_TARGET("avx2")
+void Wav::avx2_kernel(const int16_t *pcm, int n_samples, double *values)
+{
+	int i = 0;
+	for (; i + 8 <= n_samples; i += 8)
+	{
+		const __m256i widened = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pcm + i)));
+		_mm256_storeu_pd(values + i, _mm256_cvtepi32_pd(_mm256_castsi256_si128(widened)));
+		_mm256_storeu_pd(values + i + 4, _mm256_cvtepi32_pd(_mm256_extracti128_si256(widened, 1)));
+	}
+	scalar_kernel(pcm + i, n_samples - i, values + i);
+}
+
+SR_LIB_TARGET("avx2")
+void Wav::avx2_kernel(const int16_t *pcm, int n_samples, float *values)
+{
+	int i = 0;
+	for (; i + 8 <= n_samples; i += 8)
+	{
+		const __m256i widened = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pcm + i)));
+		_mm256_storeu_ps(values + i, _mm256_cvtepi32_ps(widened));
+	}
+	scalar_kernel(pcm + i, n_samples - i, values + i);
+}
+#else
+void Wav::avx2_kernel(const int16_t *pcm, int n_samples, double *values)
+{
+	scalar_kernel(pcm, n_samples, values);
+}
+
+void Wav::avx2_kernel(const int16_t *pcm, int n_samples, float *values)
+{
+	scalar_kernel(pcm, n_samples, values);
+}
+#endif